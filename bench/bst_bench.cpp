@@ -0,0 +1,392 @@
+#include <lib/BST.cpp>
+#include <lib/BTree.cpp>
+#include <benchmark/benchmark.h>
+#ifdef BST_BENCH_HAVE_ABSL
+#include <absl/container/btree_set.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef BST_BENCH_MAX_ELEMENTS
+#define BST_BENCH_MAX_ELEMENTS 1000000
+#endif
+
+// Results go to bst_bench.json as well as to the console unless --benchmark_out is passed.
+// Container sizes run from 1K up to BST_BENCH_MAX_ELEMENTS (a CMake cache variable) by powers of ten.
+
+namespace {
+
+using Key = uint64_t;
+
+constexpr int64_t kMinElements = 1000;
+constexpr int64_t kMaxElements = BST_BENCH_MAX_ELEMENTS;
+// Lookups per iteration of the find and lower_bound benchmarks.
+constexpr size_t kLookups = 1 << 16;
+constexpr double kZipfTheta = 0.99;
+// Scatters Zipfian ranks over the key space, so that the hot keys are not neighbours.
+constexpr uint64_t kScatter = 2654435761u;
+
+enum class Distribution { kRandom, kSorted, kReverse, kZipf };
+
+constexpr std::string_view Name(Distribution dist) {
+    switch (dist) {
+        case Distribution::kRandom:
+            return "random";
+        case Distribution::kSorted:
+            return "sorted";
+        case Distribution::kReverse:
+            return "reverse";
+        case Distribution::kZipf:
+            return "zipf";
+    }
+    return "";
+}
+
+// Draws ranks in [0, n) with P(rank) proportional to 1 / (rank + 1)^theta (Gray et al., SIGMOD 1994).
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double theta) : n_(n), theta_(theta), alpha_(1.0 / (1.0 - theta)) {
+        zetan_ = Zeta(n, theta);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - Zeta(2, theta) / zetan_);
+    }
+
+    uint64_t operator()(std::mt19937_64& gen) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        double uz = u * zetan_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta_)) {
+            return 1;
+        }
+        auto rank = static_cast<uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        return std::min(rank, n_ - 1);
+    }
+
+private:
+    uint64_t n_;
+    double theta_;
+    double alpha_;
+    double zetan_;
+    double eta_;
+
+    static double Zeta(uint64_t n, double theta) {
+        static std::map<std::pair<uint64_t, double>, double> cache;
+        auto [it, inserted] = cache.try_emplace({n, theta}, 0.0);
+        if (inserted) {
+            for (uint64_t i = 1; i <= n; ++i) {
+                it->second += 1.0 / std::pow(static_cast<double>(i), theta);
+            }
+        }
+        return it->second;
+    }
+};
+
+// Stored keys are the odd numbers 1, 3, ..., 2n - 1, so even probes always miss.
+Key StoredKey(uint64_t index) { return 2 * index + 1; }
+
+// Keys in the order a workload produces them: n distinct keys for random, sorted and reverse,
+// n skewed draws with repeats for zipf.
+std::vector<Key> MakeKeys(Distribution dist, uint64_t n, uint64_t seed) {
+    std::vector<Key> keys(n);
+    std::mt19937_64 gen(seed);
+    switch (dist) {
+        case Distribution::kRandom:
+            for (uint64_t i = 0; i < n; ++i) {
+                keys[i] = StoredKey(i);
+            }
+            std::shuffle(keys.begin(), keys.end(), gen);
+            break;
+        case Distribution::kSorted:
+            for (uint64_t i = 0; i < n; ++i) {
+                keys[i] = StoredKey(i);
+            }
+            break;
+        case Distribution::kReverse:
+            for (uint64_t i = 0; i < n; ++i) {
+                keys[i] = StoredKey(n - 1 - i);
+            }
+            break;
+        case Distribution::kZipf: {
+            ZipfGenerator zipf(n, kZipfTheta);
+            for (uint64_t i = 0; i < n; ++i) {
+                keys[i] = StoredKey(zipf(gen) * kScatter % n);
+            }
+            break;
+        }
+    }
+    return keys;
+}
+
+// kLookups probes into a container holding every stored key below 2n; Miss shifts them onto
+// the even numbers in between.
+template <bool Miss>
+std::vector<Key> MakeProbes(Distribution dist, uint64_t n, uint64_t seed) {
+    std::vector<Key> probes(kLookups);
+    std::mt19937_64 gen(seed);
+    ZipfGenerator zipf(dist == Distribution::kZipf ? n : 2, kZipfTheta);
+    for (size_t i = 0; i < kLookups; ++i) {
+        uint64_t index = 0;
+        switch (dist) {
+            case Distribution::kRandom:
+                index = gen() % n;
+                break;
+            case Distribution::kSorted:
+                index = i * n / kLookups;
+                break;
+            case Distribution::kReverse:
+                index = n - 1 - i * n / kLookups;
+                break;
+            case Distribution::kZipf:
+                index = zipf(gen) * kScatter % n;
+                break;
+        }
+        probes[i] = StoredKey(index) - (Miss ? 1 : 0);
+    }
+    return probes;
+}
+
+// Sorted std::vector baseline; building it sorts once instead of inserting one by one.
+class SortedVector {
+public:
+    using value_type = Key;
+
+    void insert(Key key) {
+        auto it = std::lower_bound(data_.begin(), data_.end(), key);
+        if (it == data_.end() || *it != key) {
+            data_.insert(it, key);
+        }
+    }
+
+    void build(const std::vector<Key>& keys) {
+        data_ = keys;
+        std::sort(data_.begin(), data_.end());
+        data_.erase(std::unique(data_.begin(), data_.end()), data_.end());
+    }
+
+    std::vector<Key>::const_iterator find(Key key) const {
+        auto it = std::lower_bound(data_.begin(), data_.end(), key);
+        return (it != data_.end() && *it == key) ? it : data_.end();
+    }
+
+    std::vector<Key>::const_iterator lower_bound(Key key) const { return std::lower_bound(data_.begin(), data_.end(), key); }
+
+    size_t erase(Key key) {
+        auto it = find(key);
+        if (it == data_.end()) {
+            return 0;
+        }
+        data_.erase(it);
+        return 1;
+    }
+
+    void clear() { data_.clear(); }
+
+    size_t size() const { return data_.size(); }
+
+    std::vector<Key>::const_iterator begin() const { return data_.begin(); }
+
+    std::vector<Key>::const_iterator end() const { return data_.end(); }
+
+private:
+    std::vector<Key> data_;
+};
+
+template <typename Container>
+void Build(Container& container, const std::vector<Key>& keys) {
+    if constexpr (std::is_same_v<Container, SortedVector>) {
+        container.build(keys);
+    } else {
+        for (Key key : keys) {
+            container.insert(key);
+        }
+    }
+}
+
+template <typename Container>
+Container Filled(uint64_t n) {
+    Container container;
+    Build(container, MakeKeys(Distribution::kRandom, n, 1));
+    return container;
+}
+
+template <typename Container, typename OrderType>
+auto Begin(const Container& container) {
+    if constexpr (std::is_same_v<OrderType, inorder_tag>) {
+        return container.begin();
+    } else {
+        return container.template begin<OrderType>();
+    }
+}
+
+template <typename Container, typename OrderType>
+auto End(const Container& container) {
+    if constexpr (std::is_same_v<OrderType, inorder_tag>) {
+        return container.end();
+    } else {
+        return container.template end<OrderType>();
+    }
+}
+
+template <typename Container>
+void BM_Insert(benchmark::State& state, Distribution dist) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    std::vector<Key> keys = MakeKeys(dist, n, 2);
+    for (auto _ : state) {
+        auto* container = new Container;
+        Build(*container, keys);
+        benchmark::DoNotOptimize(container);
+        state.PauseTiming();
+        delete container;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+template <typename Container, bool Miss>
+void BM_Lookup(benchmark::State& state, Distribution dist) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    Container container = Filled<Container>(n);
+    std::vector<Key> probes = MakeProbes<Miss>(dist, n, 3);
+    for (auto _ : state) {
+        for (Key probe : probes) {
+            if constexpr (Miss) {
+                benchmark::DoNotOptimize(container.lower_bound(probe));
+            } else {
+                benchmark::DoNotOptimize(container.find(probe));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+template <typename Container>
+void BM_Erase(benchmark::State& state, Distribution dist) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    std::vector<Key> keys = MakeKeys(dist, n, 4);
+    Container full = Filled<Container>(n);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto* container = new Container(full);
+        state.ResumeTiming();
+        for (Key key : keys) {
+            benchmark::DoNotOptimize(container->erase(key));
+        }
+        state.PauseTiming();
+        delete container;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+template <typename Container, typename OrderType>
+void BM_Traverse(benchmark::State& state) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    Container container = Filled<Container>(n);
+    for (auto _ : state) {
+        Key sum = 0;
+        for (auto it = Begin<Container, OrderType>(container); it != End<Container, OrderType>(container); ++it) {
+            sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+template <typename Container>
+void BM_Copy(benchmark::State& state) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    Container container = Filled<Container>(n);
+    for (auto _ : state) {
+        auto* copy = new Container(container);
+        benchmark::DoNotOptimize(copy);
+        state.PauseTiming();
+        delete copy;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+template <typename Container>
+void BM_Clear(benchmark::State& state) {
+    auto n = static_cast<uint64_t>(state.range(0));
+    Container full = Filled<Container>(n);
+    for (auto _ : state) {
+        state.PauseTiming();
+        Container container(full);
+        state.ResumeTiming();
+        container.clear();
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+}
+
+void Sizes(benchmark::internal::Benchmark* bench) {
+    for (int64_t n = kMinElements; n <= kMaxElements; n *= 10) {
+        bench->Arg(n);
+    }
+}
+
+template <typename Container>
+void RegisterContainer(const std::string& name) {
+    constexpr bool kTree = !std::is_same_v<Container, SortedVector>;
+    constexpr bool kOrders = requires(const Container& container) { container.template begin<preorder_tag>(); };
+    for (Distribution dist : {Distribution::kRandom, Distribution::kSorted, Distribution::kReverse, Distribution::kZipf}) {
+        std::string suffix = name + "/" + std::string(Name(dist));
+        benchmark::RegisterBenchmark(("insert/" + suffix).c_str(), BM_Insert<Container>, dist)->Apply(Sizes);
+        benchmark::RegisterBenchmark(("find/" + suffix).c_str(), BM_Lookup<Container, false>, dist)->Apply(Sizes);
+        benchmark::RegisterBenchmark(("lower_bound/" + suffix).c_str(), BM_Lookup<Container, true>, dist)->Apply(Sizes);
+        // Erasing one by one from a sorted vector is quadratic.
+        if constexpr (kTree) {
+            benchmark::RegisterBenchmark(("erase/" + suffix).c_str(), BM_Erase<Container>, dist)->Apply(Sizes);
+        }
+    }
+    benchmark::RegisterBenchmark(("inorder/" + name).c_str(), BM_Traverse<Container, inorder_tag>)->Apply(Sizes);
+    if constexpr (kOrders) {
+        benchmark::RegisterBenchmark(("preorder/" + name).c_str(), BM_Traverse<Container, preorder_tag>)->Apply(Sizes);
+        benchmark::RegisterBenchmark(("postorder/" + name).c_str(), BM_Traverse<Container, postorder_tag>)->Apply(Sizes);
+    }
+    benchmark::RegisterBenchmark(("copy/" + name).c_str(), BM_Copy<Container>)->Apply(Sizes);
+    benchmark::RegisterBenchmark(("clear/" + name).c_str(), BM_Clear<Container>)->Apply(Sizes);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    RegisterContainer<BinarySearchTree<Key>>("BinarySearchTree");
+    RegisterContainer<BinarySearchTree<Key, std::less<Key>, std::allocator<Key>, avl_tag>>("BinarySearchTreeAVL");
+    RegisterContainer<BinarySearchTree<Key, std::less<Key>, std::allocator<Key>, red_black_tag, no_augment_tag, threaded_tag>>(
+        "BinarySearchTreeThreaded");
+    RegisterContainer<BTree<Key>>("BTree");
+    RegisterContainer<std::set<Key>>("std::set");
+#ifdef BST_BENCH_HAVE_ABSL
+    RegisterContainer<absl::btree_set<Key>>("absl::btree_set");
+#endif
+    RegisterContainer<SortedVector>("sorted_vector");
+
+    std::vector<char*> args(argv, argv + argc);
+    bool has_out = std::any_of(args.begin(), args.end(), [](const char* arg) {
+        return std::string_view(arg).starts_with("--benchmark_out=");
+    });
+    std::string out = "--benchmark_out=bst_bench.json";
+    std::string format = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(out.data());
+        args.push_back(format.data());
+    }
+    int count = static_cast<int>(args.size());
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
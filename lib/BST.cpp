@@ -1,46 +1,201 @@
+#pragma once
+
 #include <iostream>
 #include <type_traits>
 #include <memory>
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <algorithm>
+#include <utility>
+#include <optional>
+#include <bit>
+#include <future>
+#include <thread>
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <ranges>
 
 struct inorder_tag {};
 struct preorder_tag {};
 struct postorder_tag {};
 
-template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+struct red_black_tag {};
+struct avl_tag {};
+struct unbalanced_tag {};
+
+// threaded_tag also links every node to its inorder neighbours: inorder ++/-- is one load,
+// at the price of two pointers per node and an O(n) relink after bulk operations.
+struct unthreaded_tag {};
+struct threaded_tag {};
+
+struct no_augment_tag {};
+// Every node counts the nodes of its subtree: enables nth, rank, count_range and O(log n) distance.
+struct order_statistics_tag {};
+
+// Any type with value_type, identity(), lift(const T&) and an associative combine(a, b) can be
+// passed as Augment: every node then also keeps the in-order combination of its subtree,
+// which answers aggregate(lo, hi) in O(log n). Order statistics come along with it.
+template <typename T>
+struct sum_monoid {
+    using value_type = T;
+    static value_type identity() { return T(); }
+    static value_type lift(const T& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return a + b; }
+};
+
+template <typename T>
+struct min_monoid {
+    using value_type = T;
+    static value_type identity() { return std::numeric_limits<T>::max(); }
+    static value_type lift(const T& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return std::min(a, b); }
+};
+
+template <typename T>
+struct max_monoid {
+    using value_type = T;
+    static value_type identity() { return std::numeric_limits<T>::lowest(); }
+    static value_type lift(const T& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return std::max(a, b); }
+};
+
+// Compare that counts its calls. With BST_ENABLE_STATS defined, BinarySearchTree keeps its
+// comparator in one of these; copies start counting from zero.
+template <typename Compare>
+struct counting_compare {
+    Compare comp{};
+    mutable std::atomic<uint64_t> calls{0};
+
+    counting_compare() = default;
+    counting_compare(const Compare& other) : comp(other) {}
+    counting_compare(const counting_compare& other) : comp(other.comp) {}
+
+    counting_compare& operator=(const counting_compare& other) {
+        comp = other.comp;
+        return *this;
+    }
+
+    operator const Compare&() const { return comp; }
+
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        return comp(a, b);
+    }
+};
+
+struct sorted_unique_tag {};
+// Selects the overloads that fork independent subtrees onto other threads.
+struct parallel_tag {};
+
+template <typename T, typename Compare, typename Alloc>
+class FrozenTree;
+
+// Elements of the map containers; their key is const, so the mapped value may stay writable.
+template <typename T>
+inline constexpr bool is_map_value_v = false;
+
+template <typename K, typename V>
+inline constexpr bool is_map_value_v<std::pair<const K, V>> = true;
+
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>, typename Balance = red_black_tag,
+          typename Augment = no_augment_tag, typename Threading = unthreaded_tag>
 class BinarySearchTree {
 private:
+    // The map and multi containers of lib/BSTMap.cpp are built on the private interface.
+    template <typename, typename, typename, typename, typename, typename, bool>
+    friend class KeyedTree;
+
     struct Node; 
 
+    static constexpr bool counted_ = !std::is_same_v<Augment, no_augment_tag>;
+
+    static constexpr bool aggregated_ = requires { typename Augment::value_type; Augment::identity(); };
+
+    static constexpr bool threaded_ = std::is_same_v<Threading, threaded_tag>;
+
+    struct NoWeight {};
+
+    struct Thread {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+    };
+
+    struct NoAggregate {
+        using value_type = NoWeight;
+    };
+
+    using AggregateValue = typename std::conditional_t<aggregated_, Augment, NoAggregate>::value_type;
+
     struct BaseNode {
         Node* left = nullptr;
         Node* right = nullptr;
         Node* parent = nullptr;
+        // red_black_tag: 0 - red, 1 - black; avl_tag: height of the subtree (leaf = 0)
+        signed char balance_ = 0;
+        // Number of nodes in the subtree, kept only by augmented trees.
+        [[no_unique_address]] std::conditional_t<counted_, size_t, NoWeight> weight_{};
+        // Inorder neighbours, kept only by threaded trees; the fake node closes them into a ring.
+        [[no_unique_address]] std::conditional_t<threaded_, Thread, NoWeight> thread_{};
     };
 
     struct Node: BaseNode {
         T data_;
-        Node(const T& data) : data_(data) {}
+        // Augment::combine over the subtree in order, kept only by aggregated trees.
+        [[no_unique_address]] AggregateValue aggregate_{};
+        template <typename... Args>
+        Node(Args&&... args) : data_(std::forward<Args>(args)...) {}
     };
 
     BaseNode* fake_node_;
     BaseNode base_node_;
-    std::allocator_traits<Alloc>::template rebind_alloc<Node> alloc_;
-    Compare comp_;
+    using NodeAlloc = std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+
+#ifdef BST_ENABLE_STATS
+    struct Counters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> deallocations{0};
+        std::atomic<uint64_t> descents{0};
+        std::atomic<uint64_t> descent_steps{0};
+        std::atomic<uint64_t> max_descent{0};
+    };
+
+    using Comparator = counting_compare<Compare>;
+    mutable Counters counters_;
+#else
+    using Comparator = Compare;
+#endif
+
+    NodeAlloc alloc_;
+    Comparator comp_;
     size_t size_;
 
+    static constexpr bool is_transparent_ = requires { typename Compare::is_transparent; };
+
+    // Iterators hand out writable map elements unless subtree aggregates depend on the values.
+    static constexpr bool mutable_value_ = is_map_value_v<T> && !aggregated_;
+
     template <typename OrderType = inorder_tag>
     class base_iterator {
     friend BinarySearchTree;
+    template <typename, typename, typename, typename, typename, typename, bool>
+    friend class KeyedTree;
     public:
-        using pointer_type = const T*;
-        using referense_type = const T&;
-        using value_type = BaseNode;
-        using difference_type = size_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<mutable_value_, T*, const T*>;
+        using reference = std::conditional_t<mutable_value_, T&, const T&>;
+        using pointer_type = pointer;
+        using referense_type = reference;
         using key_type = const T;
 
+        // Singular: may only be assigned to or compared with another singular iterator.
+        base_iterator() = default;
         base_iterator(const base_iterator&) = default;
         base_iterator& operator=(const base_iterator&) = default;
 
@@ -59,6 +214,10 @@ private:
         }
 
         base_iterator& increment(inorder_tag) {
+            if constexpr (threaded_) {
+                ptr_ = ptr_->thread_.next;
+                return *this;
+            }
             if (ptr_->right != nullptr) {
                 ptr_ = ptr_->right;
                 while (ptr_->left != nullptr) {
@@ -81,12 +240,14 @@ private:
             } else if (ptr_->right != nullptr) {
                 ptr_ = ptr_->right;
             } else {
-                Node* par = ptr_->parent; 
-                while ((par->right == nullptr) || (par->right == ptr_)) {
+                // The fake node is the only one that is its own parent; its right is the leftmost
+                // node rather than a subtree, so the climb has to stop there.
+                Node* par = ptr_->parent;
+                while ((par->parent != par) && ((par->right == nullptr) || (par->right == ptr_))) {
                     ptr_ = par;
                     par = par->parent;
                 }
-                if (par->left == ptr_ && par->parent == par) {
+                if (par->parent == par) {
                     ptr_ = par;
                     return *this;
                 }
@@ -147,11 +308,15 @@ private:
 
         base_iterator operator++(int) {
             auto copy = *this;
-            ++ptr_;
+            ++*this;
             return copy;
         }
 
         base_iterator& decrement(inorder_tag) {
+            if constexpr (threaded_) {
+                ptr_ = ptr_->thread_.prev;
+                return *this;
+            }
             if (ptr_->left != nullptr) {
                 ptr_ = ptr_->left;
                 while (ptr_->right != nullptr) {
@@ -170,14 +335,22 @@ private:
 
         base_iterator operator--(int) {
             auto copy = *this;
-            --ptr_;
+            --*this;
             return copy;
         }
 
+        // Found by argument-dependent lookup: `using std::distance; distance(first, last)`.
+        friend std::ptrdiff_t distance(const base_iterator& first, const base_iterator& last)
+        requires (counted_ && std::is_same_v<OrderType, inorder_tag>) {
+            return static_cast<std::ptrdiff_t>(last.position_()) - static_cast<std::ptrdiff_t>(first.position_());
+        }
+
     private:
-        value_type* ptr_;
+        BaseNode* ptr_ = nullptr;
+
+        size_t position_() const { return index_(ptr_); }
 
-        base_iterator(value_type* ptr) : ptr_(ptr) {}
+        base_iterator(BaseNode* ptr) : ptr_(ptr) {}
     };
 
 public:
@@ -210,11 +383,128 @@ public:
     using AllocTraits = std::allocator_traits<typename std::allocator_traits<Alloc>::template rebind_alloc<node_type>>;
     using allocator_type = Alloc;
 
+    // End of a range() scan: an iterator reaches it at end() or at the first element past hi,
+    // so finding the end costs no descent. Points into its range_view.
+    template <typename K>
+    class range_sentinel {
+    friend BinarySearchTree;
+    public:
+        range_sentinel() = default;
+
+        friend bool operator==(const iterator<>& it, const range_sentinel& last) { return last.reached_(it); }
+
+    private:
+        const BinarySearchTree* tree_ = nullptr;
+        const K* hi_ = nullptr;
+
+        bool reached_(const iterator<>& it) const { return it == tree_->end() || tree_->comp_(*hi_, *it); }
+
+        range_sentinel(const BinarySearchTree* tree, const K* hi) : tree_(tree), hi_(hi) {}
+    };
+
+    // Lazy scan of the closed range [lo, hi]: one descent finds the first element, then every
+    // step is an iterator increment and one comparison with hi. Sized when the tree counts its
+    // subtrees; rbegin() spends a second descent to find the last element.
+    template <typename K>
+    class range_view : public std::ranges::view_interface<range_view<K>> {
+    friend BinarySearchTree;
+    public:
+        range_view() = default;
+
+        iterator<> begin() const { return first_; }
+
+        range_sentinel<K> end() const { return {tree_, &hi_}; }
+
+        reverse_iterator<> rbegin() const {
+            return reverse_iterator<>(this->empty() ? first_ : tree_->template upper_bound_<inorder_tag>(hi_));
+        }
+
+        reverse_iterator<> rend() const { return reverse_iterator<>(first_); }
+
+        size_type size() const requires counted_ {
+            return this->empty() ? 0 : tree_->template rank_<true>(hi_) - index_(first_.ptr_);
+        }
+
+    private:
+        const BinarySearchTree* tree_ = nullptr;
+        iterator<> first_;
+        K hi_{};
+
+        range_view(const BinarySearchTree* tree, iterator<> first, const K& hi) : tree_(tree), first_(first), hi_(hi) {}
+    };
+
+    class node_handle {
+    friend BinarySearchTree;
+    public:
+        using value_type = T;
+        using allocator_type = Alloc;
+
+        node_handle() = default;
+
+        node_handle(node_handle&& other) noexcept : ptr_(other.ptr_), alloc_(std::move(other.alloc_)) {
+            other.ptr_ = nullptr;
+            other.alloc_.reset();
+        }
+
+        node_handle& operator=(node_handle&& other) noexcept {
+            if (this != &other) {
+                reset_();
+                ptr_ = other.ptr_;
+                alloc_ = std::move(other.alloc_);
+                other.ptr_ = nullptr;
+                other.alloc_.reset();
+            }
+            return *this;
+        }
+
+        ~node_handle() { reset_(); }
+
+        bool empty() const { return ptr_ == nullptr; }
+
+        explicit operator bool() const { return ptr_ != nullptr; }
+
+        value_type& value() const { return ptr_->data_; }
+
+        allocator_type get_allocator() const { return *alloc_; }
+
+    private:
+        node_type* ptr_ = nullptr;
+        std::optional<NodeAlloc> alloc_;
+
+        node_handle(node_type* ptr, const NodeAlloc& alloc) : ptr_(ptr), alloc_(alloc) {}
+
+        void reset_() {
+            if (ptr_ != nullptr) {
+                AllocTraits::destroy(*alloc_, ptr_);
+                alloc_->deallocate(ptr_, 1);
+                ptr_ = nullptr;
+            }
+            alloc_.reset();
+        }
+    };
+
+    struct insert_return_type {
+        iterator<> position;
+        bool inserted;
+        node_handle node;
+    };
+
     node_type* beg_(inorder_tag) const { return fake_node_->right; }
 
-    node_type* beg_(preorder_tag) const { return fake_node_->left; }
+    node_type* beg_(preorder_tag) const {
+        return (fake_node_->left != nullptr) ? fake_node_->left : static_cast<node_type*>(fake_node_);
+    }
 
-    node_type* beg_(postorder_tag) const { return fake_node_->right; }
+    node_type* beg_(postorder_tag) const {
+        node_type* now = fake_node_->left;
+        if (now == nullptr) {
+            return static_cast<node_type*>(fake_node_);
+        }
+        while (now->left != nullptr || now->right != nullptr) {
+            now = (now->left != nullptr) ? now->left : now->right;
+        }
+        return now;
+    }
 
     template <typename OrderType = inorder_tag>
     const_iterator<OrderType> begin() const { return iterator<OrderType>(beg_(OrderType{})); }
@@ -240,17 +530,14 @@ public:
     template <typename OrderType = inorder_tag>
     const_reverse_iterator<OrderType> crend() const {return reverse_iterator<OrderType>(begin<OrderType>()); }
 
-    BinarySearchTree() : fake_node_(&base_node_), size_(0), comp_(), alloc_() {
+    BinarySearchTree() : fake_node_(&base_node_), alloc_(), comp_(), size_(0) {
         fake_node_->parent = static_cast<node_type*>(fake_node_);
         fake_node_->right = static_cast<node_type*>(fake_node_);
+        close_ring_();
     }
 
-    BinarySearchTree(const_reference element) : fake_node_(&base_node_), size_(1), comp_(), alloc_() {
-        fake_node_->left = alloc_.allocate(1);
-        AllocTraits::construct(alloc_, fake_node_->left, element);
-        fake_node_->left->parent = static_cast<node_type*>(fake_node_);
-        fake_node_->right = fake_node_->left;
-        fake_node_->parent = static_cast<Node*>(fake_node_);
+    BinarySearchTree(const_reference element) : BinarySearchTree() {
+        insert(element);
     }
 
     ~BinarySearchTree() {
@@ -259,7 +546,7 @@ public:
 
     size_type size() const { return size_; }
 
-    size_type max_size() const { std::numeric_limits<size_type>::max(); }
+    size_type max_size() const { return std::numeric_limits<size_type>::max(); }
 
     bool empty() const { return (begin() == end()) ? true : false; }
 
@@ -275,35 +562,53 @@ public:
         insert(il.begin(), il.end());
     }
 
-    BinarySearchTree(const std::initializer_list<value_type>& il) 
-    : fake_node_(&base_node_), size_(0), comp_(), alloc_() {
+    BinarySearchTree(const std::initializer_list<value_type>& il) : BinarySearchTree() {
         insert(il);
     }
 
-    BinarySearchTree(const std::initializer_list<value_type>& il, key_compare comp) 
-    : fake_node_(&base_node_), size_(0), comp_(comp), alloc_() {
+    BinarySearchTree(const std::initializer_list<value_type>& il, key_compare comp) : BinarySearchTree() {
+        comp_ = comp;
         insert(il);
     }
 
     template <typename OrderType = inorder_tag>
-    BinarySearchTree(base_iterator<OrderType>& first, base_iterator<OrderType>& second) 
-    : fake_node_(&base_node_), size_(0), comp_(), alloc_() {
+    BinarySearchTree(base_iterator<OrderType>& first, base_iterator<OrderType>& second) : BinarySearchTree() {
         insert(first, second);
     }
 
     template <typename OrderType = inorder_tag>
     BinarySearchTree(base_iterator<OrderType>& first, base_iterator<OrderType>& second, key_compare comp) 
-    : fake_node_(&base_node_), size_(0), comp_(comp), alloc_() {
+    : BinarySearchTree() {
+        comp_ = comp;
         insert(first, second);
     }
 
     BinarySearchTree(const BinarySearchTree& other) 
-    : base_node_(), fake_node_(&base_node_), size_(0), comp_(other.comp_), alloc_(other.alloc_) {
+    : fake_node_(&base_node_), base_node_(),
+      alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_)), comp_(other.comp_), size_(0) {
         fake_node_->parent = static_cast<node_type*>(fake_node_);
         fake_node_->right = static_cast<node_type*>(fake_node_);
-        for (auto el = other.begin<preorder_tag>(); el != other.end<preorder_tag>(); ++el) {
-            insert(*el);
-        }
+        close_ring_();
+        clone_(other);
+    }
+
+    BinarySearchTree(BinarySearchTree&& other) noexcept
+    : fake_node_(&base_node_), alloc_(std::move(other.alloc_)), comp_(std::move(other.comp_)), size_(0) {
+        fake_node_->parent = static_cast<node_type*>(fake_node_);
+        fake_node_->right = static_cast<node_type*>(fake_node_);
+        close_ring_();
+        steal_(other);
+    }
+
+    template <typename It>
+    BinarySearchTree(sorted_unique_tag, It first, It last) : BinarySearchTree() {
+        assign_sorted(first, last);
+    }
+
+    template <std::random_access_iterator It>
+    requires AllocTraits::is_always_equal::value
+    BinarySearchTree(parallel_tag, sorted_unique_tag, It first, It last) : BinarySearchTree() {
+        assign_sorted(parallel_tag{}, first, last);
     }
 
     BinarySearchTree& operator=(std::initializer_list<value_type> il) {
@@ -313,176 +618,168 @@ public:
     }
 
     BinarySearchTree& operator=(const BinarySearchTree& other) {
-        if (*this == other) {
+        if (this == &other) {
             return *this;
         }
         clear();
-        alloc_ = other.alloc_;
-        comp_ = other.comp_;
-        for (auto el = other.begin<preorder_tag>(); el != other.end<preorder_tag>(); ++el) {
-            insert(*el);
+        if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+            alloc_ = other.alloc_;
         }
+        comp_ = other.comp_;
+        clone_(other);
         return *this;
     }
 
-    template <typename OrderType = inorder_tag>
-    iterator<OrderType> find(const_reference key) const {
-        node_type* now = static_cast<node_type*>(fake_node_->left);
-        while (now != nullptr) {
-            if ((now != nullptr) && (now->data_ == key)) {
-                return iterator<OrderType>{now};
-            }
-            if (comp_(key, now->data_)) {
-                now = now->left;
-            } else if (comp_(now->data_, key)) {
-                now = now->right;
+    BinarySearchTree& operator=(BinarySearchTree&& other) noexcept(AllocTraits::is_always_equal::value 
+                                                                  || AllocTraits::propagate_on_container_move_assignment::value) {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        comp_ = std::move(other.comp_);
+        if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+            alloc_ = std::move(other.alloc_);
+            steal_(other);
+        } else if (AllocTraits::is_always_equal::value || alloc_ == other.alloc_) {
+            steal_(other);
+        } else {
+            for (auto it = other.begin(); it != other.end(); ++it) {
+                insert(std::move(static_cast<node_type*>(it.ptr_)->data_));
             }
+            other.clear();
         }
-        return end();
+        return *this;
+    }
+
+    // [first, last) must be strictly increasing by key_comp(); no comparisons are made.
+    template <typename It>
+    void assign_sorted(It first, It last) {
+        clear();
+        size_type count = std::distance(first, last);
+        if (count == 0) {
+            return;
+        }
+        fake_node_->left = build_(first, count, 0, full_depth_(count), static_cast<node_type*>(fake_node_));
+        fake_node_->right = leftmost_(fake_node_->left);
+        size_ = count;
+        thread_all_();
     }
 
-    bool insert_spec(inorder_tag, Node* elem) const { return false; }
+    // Builds the two halves of every large enough subtree on different threads.
+    template <std::random_access_iterator It>
+    requires AllocTraits::is_always_equal::value
+    void assign_sorted(parallel_tag, It first, It last) {
+        clear();
+        size_type count = last - first;
+        if (count == 0) {
+            return;
+        }
+        adopt_(build_parallel_(first, count, 0, full_depth_(count), fork_depth_(count)), count);
+    }
 
-    bool insert_spec(preorder_tag, Node* elem) const { return false; }
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> find(const_reference key) const { return find_<OrderType>(key); }
 
-    bool insert_spec(postorder_tag, Node* elem) const { return ((elem != nullptr)) ? false : true; }
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find(const K& key) const { return find_<OrderType>(key); }
 
     template <typename OrderType = inorder_tag>
     std::pair<iterator<OrderType>, bool> insert(const_reference key) {
-        node_type* val = alloc_.allocate(1);
-        AllocTraits::construct(alloc_, val, key);
-        if (fake_node_->left == nullptr) {
-            fake_node_->left = val;
-            fake_node_->left->parent = static_cast<node_type*>(fake_node_);
-            fake_node_->right = val;
-            ++size_;
-            return std::pair(iterator<OrderType>{val}, true);
+        return emplace_at_<OrderType>(key, key);
+    }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, bool> insert(value_type&& key) {
+        return emplace_at_<OrderType>(key, std::move(key));
+    }
+
+    template <typename OrderType = inorder_tag, typename... Args>
+    std::pair<iterator<OrderType>, bool> emplace(Args&&... args) {
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return emplace_at_<OrderType>(args..., std::forward<Args>(args)...);
+        } else {
+            node_type* val = create_node_(std::forward<Args>(args)...);
+            auto res = insert_node_<OrderType>(val);
+            if (!res.second) {
+                drop_node_(val);
+            }
+            return res;
         }
-        node_type* now = static_cast<node_type*>(fake_node_->left);
-        bool flag = true;
-        while (now != nullptr) {
-            if (comp_(now->data_, val->data_)) {
-                flag = insert_spec(OrderType{}, now->left);
-                if (now->right != nullptr) {
-                    now = now->right;
-                } else {
-                    now->right = val;
-                    val->parent = now;
-                    break;
-                }
-            } else if (comp_(val->data_, now->data_)) {
-                if (now->left != nullptr) {
-                    now = now->left;
-                } else {
-                    now->left = val;
-                    val->parent = now;
-                    break;
-                }
-            } else {
-                return std::pair(iterator<OrderType>{now}, false);
+    }
+
+    // Looks key up first and constructs value_type(key, args...) only if no equivalent element exists.
+    template <typename OrderType = inorder_tag, typename K, typename... Args>
+    std::pair<iterator<OrderType>, bool> try_emplace(K&& key, Args&&... args) {
+        return emplace_at_<OrderType>(key, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    // A hint right after or right before the new element costs amortized O(1): no descent,
+    // only the rebalancing. Any other hint falls back to a finger search from it.
+    template <typename... Args>
+    iterator<> emplace_hint(iterator<> hint, Args&&... args) {
+        node_type* near = static_cast<node_type*>(hint.ptr_);
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return emplace_near_(near, args..., std::forward<Args>(args)...);
+        } else {
+            node_type* val = create_node_(std::forward<Args>(args)...);
+            Position pos = locate_near_(near, val->data_);
+            if (pos.found) {
+                drop_node_(val);
+                return iterator<>{pos.node};
             }
+            attach_(pos.node, pos.to_left, val);
+            return iterator<>{val};
         }
-        if (flag) {
-            fake_node_->right = val;
+    }
+
+    iterator<> insert(iterator<> hint, const_reference key) {
+        return emplace_near_(static_cast<node_type*>(hint.ptr_), key, key);
+    }
+
+    iterator<> insert(iterator<> hint, value_type&& key) {
+        return emplace_near_(static_cast<node_type*>(hint.ptr_), key, std::move(key));
+    }
+
+    insert_return_type insert(node_handle&& handle) {
+        if (handle.empty()) {
+            return {end(), false, node_handle()};
         }
-        ++size_;
-        return std::pair(iterator<OrderType>{val}, true);
+        if (!(AllocTraits::is_always_equal::value || *handle.alloc_ == alloc_)) {
+            auto res = insert(std::move(handle.value()));
+            handle.reset_();
+            return {res.first, res.second, node_handle()};
+        }
+        auto res = insert_node_<inorder_tag>(handle.ptr_);
+        if (!res.second) {
+            return {res.first, false, std::move(handle)};
+        }
+        handle.ptr_ = nullptr;
+        handle.alloc_.reset();
+        return {res.first, true, node_handle()};
+    }
+
+    node_handle extract(iterator<> pos) {
+        node_type* elem = static_cast<node_type*>(pos.ptr_);
+        detach_(elem);
+        return node_handle(elem, alloc_);
+    }
+
+    node_handle extract(const_reference key) {
+        auto it = find(key);
+        if (it == end()) {
+            return node_handle();
+        }
+        return extract(it);
     }
 
     template <typename OrderType = inorder_tag>
     iterator<OrderType> erase(iterator<OrderType> val) { 
         node_type* elem = static_cast<node_type*>(val.ptr_);
-        node_type* par = static_cast<node_type*>(elem->parent);
-        if (elem->left == nullptr && elem->right == nullptr) {
-            if (par == fake_node_) {
-                fake_node_->left = nullptr;
-                fake_node_->right = static_cast<node_type*>(fake_node_);
-            } else {
-                
-                if (par->left == elem) {
-                    par->left = nullptr;
-                    if (elem == fake_node_->right) {
-                        fake_node_->right = par;
-                    }
-                } else {
-                    if (fake_node_->right == elem) {
-                        fake_node_->right = par;
-                    }
-                    par->right = nullptr;
-                }
-            
-            }
-            ++val;
-            AllocTraits::destroy(alloc_, elem);
-            alloc_.deallocate(elem, 1);
-            return val;
-        } else if (elem->left == nullptr || elem->right == nullptr) {
-            if (elem->left == nullptr) {
-                if (par == fake_node_) {
-                    elem->right->parent = static_cast<node_type*>(fake_node_);
-                    fake_node_->left = elem->right;
-                    Node* sub = elem->right;
-                    while (sub->left != nullptr) {
-                        sub = sub->left;
-                    }
-                    fake_node_->right = sub;
-                    
-                } else {
-                    if (par->left == elem) {
-                        par->left = elem->right;
-                    } else {
-                        par->right = elem->right;
-                    }
-                    elem->right->parent = par;
-                    if (elem == fake_node_->right) {
-                        node_type* sub = elem->right;
-                        while (sub->left != nullptr) {
-                            sub = sub->left;
-                        }
-                        fake_node_->right = sub;
-                    }
-                }
-            } else {
-                if (par == fake_node_) {
-                    elem->left->parent = static_cast<node_type*>(fake_node_);
-                    fake_node_->left = elem->left;
-                } else {
-                    if (par->left == elem) {
-                        par->left = elem->left;
-                    } else {
-                        par->right = elem->left;
-                    }
-                    elem->left->parent = par;
-                }
-            }
-            ++val;
-            AllocTraits::destroy(alloc_, elem);
-            alloc_.deallocate(elem, 1);
-            return val;
-        } else {
-            auto it = val;
-            ++val;
-            node_type* next = static_cast<node_type*>(val.ptr_);
-            elem->data_ = next->data_;
-            if (next->parent->left == next) {
-                next->parent->left = next->right;
-                if (next->right != nullptr) {
-                    next->right->parent = next->parent;
-                }
-            } else {
-                next->parent->right = next->right;
-                if (next->right != nullptr) {
-                    next->right->parent = next->parent;
-                }
-            }
-            if (par == fake_node_) {
-                fake_node_->left = elem;
-            }
-            AllocTraits::destroy(alloc_, next);
-            alloc_.deallocate(next, 1);
-            return it;
-        }
-        --size_;
+        ++val;
+        detach_(elem);
+        drop_node_(elem);
+        return val;
     }
 
     size_type erase(const_reference key) {
@@ -494,6 +791,17 @@ public:
         return 0;
     } 
 
+    template <typename K>
+    requires is_transparent_
+    size_type erase(const K& key) {
+        auto it = find(key);
+        if (it != end()) {
+            erase(it);
+            return 1;
+        }
+        return 0;
+    }
+
     template <typename OrderType = inorder_tag>
     iterator<OrderType> erase(iterator<OrderType> st, iterator<OrderType> fn) {
         while (st != fn) {
@@ -502,90 +810,1767 @@ public:
         return fn;
     }
 
-    void clear() { erase(begin(), end()); }
-
-    bool contains(const_reference key) const {
-        return (find(key) != end());
+    void clear() {
+        if (fake_node_->left == nullptr) {
+            return;
+        }
+        if constexpr (requires { alloc_.release(); alloc_.in_use(); }) {
+            if (alloc_.in_use() == size_) {
+                if constexpr (!std::is_trivially_destructible_v<node_type>) {
+                    destroy_subtree_<false>(fake_node_->left, alloc_);
+                }
+                alloc_.release();
+                note_free_(size_);
+                reset_();
+                return;
+            }
+        }
+        free_subtree_(fake_node_->left);
+        reset_();
     }
 
-    size_type count(const_reference key) const {
-        return (contains(key)) ? 1 : 0;
+    // Detaches every node in O(1) and leaves destroying them to reclaimer.post(job), which runs
+    // the job on another thread. Only for stateless allocators, which can be used from any thread.
+    template <typename Reclaimer>
+    requires AllocTraits::is_always_equal::value
+    void clear(Reclaimer& reclaimer) {
+        node_type* root = fake_node_->left;
+        if (root == nullptr) {
+            return;
+        }
+        note_free_(size_);
+        reset_();
+        reclaimer.post([root, alloc = alloc_]() mutable { destroy_subtree_(root, alloc); });
     }
 
-    template <typename OrderType = inorder_tag>
-    iterator<OrderType> lower_bound(const_reference key) const {
-        if (fake_node_->left == nullptr) {
-            return end();
+    // Moves the elements not less than key into the returned tree. Nodes are relinked, not copied.
+    // Needs subtree sizes (an augment) to size both parts in O(log n); without them the size of
+    // a part is unknown short of counting it.
+    BinarySearchTree split(const_reference key) requires counted_ { return split_tree_(key); }
+
+    template <typename K>
+    requires is_transparent_ && counted_
+    BinarySearchTree split(const K& key) { return split_tree_(key); }
+
+    // Appends every element of right, which must all be greater than the elements of *this.
+    void join(BinarySearchTree&& right) {
+        if (!same_pool_(right)) {
+            move_elements_(right);
+            return;
         }
-        node_type* now = static_cast<node_type*>(fake_node_->left);
-        node_type* best = nullptr;
-        while (now != nullptr) {
-            if ((now->data_ >= key) && (best == nullptr || best->data_ >= now->data_)) {
-                best = now;
-            }
-            if (comp_(key, now->data_)) {
-                now = now->left;
-                
-            } else if (comp_(now->data_, key)) {
-                now = now->right;
+        size_type count = size_ + right.size_;
+        Ends ends = ends_();
+        Ends right_ends = right.ends_();
+        node_type* root = join2_(take_root_(), right.take_root_());
+        adopt_(root, count, false);
+        if constexpr (threaded_) {
+            if (right_ends.first == right.fake_node_) {
+                ring_(ends.first, ends.last);
+            } else if (ends.first == fake_node_) {
+                ring_(right_ends.first, right_ends.last);
             } else {
-                return {now};
+                chain_(ends.last, right_ends.first);
+                ring_(ends.first, right_ends.last);
             }
         }
-        if (best == nullptr) {
-            return end();
+    }
+
+    // Like std::set::merge: moves the nodes of source whose keys are missing here,
+    // equivalent ones stay in source.
+    void merge(BinarySearchTree& source) {
+        if (this == &source) {
+            return;
+        }
+        if (!same_pool_(source)) {
+            for (auto it = source.begin(); it != source.end();) {
+                auto next = it;
+                ++next;
+                if (!contains(*it)) {
+                    insert(source.extract(it));
+                }
+                it = next;
+            }
+            return;
         }
-        return {best};
+        merge_(source, 0);
     }
 
-    
-    template <typename OrderType = inorder_tag>
-    iterator<OrderType> upper_bound(const_reference key) const {
-        if (fake_node_->left == nullptr) {
-            return end();
+    void merge(parallel_tag, BinarySearchTree& source) requires AllocTraits::is_always_equal::value {
+        if (this != &source) {
+            merge_(source, fork_depth_(size_ + source.size_));
         }
-        node_type* now = static_cast<node_type*>(fake_node_->left);
-        node_type* best = nullptr;
-        while (now != nullptr) {
-            if ((now->data_ > key) && (best == nullptr || best->data_ >= now->data_)) {
-                best = now;
+    }
+
+    // *this becomes the union of both trees; elements of other equivalent to ones here are dropped.
+    void set_union(BinarySearchTree&& other) {
+        if (!same_pool_(other)) {
+            move_elements_(other);
+            return;
+        }
+        set_union_(other, 0);
+    }
+
+    void set_union(parallel_tag, BinarySearchTree&& other) requires AllocTraits::is_always_equal::value {
+        set_union_(other, fork_depth_(size_ + other.size_));
+    }
+
+    // Keeps the elements that have an equivalent in other, which is consumed.
+    void set_intersection(BinarySearchTree&& other) {
+        if (!same_pool_(other)) {
+            for (auto it = begin(); it != end();) {
+                if (other.contains(*it)) {
+                    ++it;
+                } else {
+                    it = erase(it);
+                }
             }
-            if (comp_(key, now->data_)) {
-                now = now->left;
-                
-            } else if (comp_(now->data_, key)) {
-                now = now->right;
-            } else {
-                now = now->right;
+            other.clear();
+            return;
+        }
+        set_intersection_(other, 0);
+    }
+
+    void set_intersection(parallel_tag, BinarySearchTree&& other) requires AllocTraits::is_always_equal::value {
+        set_intersection_(other, fork_depth_(size_ + other.size_));
+    }
+
+    // Removes the elements that have an equivalent in other, which is consumed.
+    void set_difference(BinarySearchTree&& other) {
+        if (!same_pool_(other)) {
+            for (auto it = other.begin(); it != other.end(); ++it) {
+                erase(*it);
             }
+            other.clear();
+            return;
+        }
+        set_difference_(other, 0);
+    }
+
+    void set_difference(parallel_tag, BinarySearchTree&& other) requires AllocTraits::is_always_equal::value {
+        set_difference_(other, fork_depth_(size_ + other.size_));
+    }
+
+    // Calls f on every element; subtrees are visited concurrently and in no particular order.
+    template <typename F>
+    void for_each(parallel_tag, F f) const {
+        if (fake_node_->left != nullptr) {
+            for_each_(fake_node_->left, f, fork_depth_(size_));
         }
-        if (best == nullptr) {
-            return end();
+    }
+
+    // Folds the elements in order with an associative op: op(U, const T&) and op(U, U) must be
+    // valid and T must convert to U. Subtrees are folded concurrently.
+    template <typename U, typename BinaryOp>
+    U reduce(parallel_tag, U init, BinaryOp op) const {
+        if (fake_node_->left == nullptr) {
+            return init;
         }
-        return {best};
+        return op(std::move(init), reduce_<U>(fake_node_->left, op, fork_depth_(size_)));
     }
 
+    // Finger search: O(log d) in a balanced tree, where d is the distance between finger and key.
     template <typename OrderType = inorder_tag>
-    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const_reference key) const {
-        return std::make_pair(lower_bound(key), upper_bound(key));
+    iterator<OrderType> find_from(iterator<OrderType> finger, const_reference key) const {
+        return find_from_<OrderType>(static_cast<node_type*>(finger.ptr_), key);
     }
 
-    key_compare key_comp() const { return comp_; }
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find_from(iterator<OrderType> finger, const K& key) const {
+        return find_from_<OrderType>(static_cast<node_type*>(finger.ptr_), key);
+    }
+
+    // Batched lookups: out[i] receives the result for keys[i], out must be at least as long as keys.
+    // Descents run in lockstep groups so that their cache misses overlap; in a sorted batch
+    // each group starts below the part of the path that all its keys share.
+    template <typename OrderType = inorder_tag>
+    void find_batch(std::span<const key_type> keys, std::type_identity_t<std::span<iterator<OrderType>>> out) const {
+        find_batch_<OrderType>(keys, out);
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    void find_batch(std::span<const K> keys, std::type_identity_t<std::span<iterator<OrderType>>> out) const {
+        find_batch_<OrderType>(keys, out);
+    }
+
+    template <typename OrderType = inorder_tag>
+    void lower_bound_batch(std::span<const key_type> keys, std::type_identity_t<std::span<iterator<OrderType>>> out) const {
+        batch_(keys, [&](size_type i, node_type* elem) { out[i] = iterator<OrderType>{elem}; });
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    void lower_bound_batch(std::span<const K> keys, std::type_identity_t<std::span<iterator<OrderType>>> out) const {
+        batch_(keys, [&](size_type i, node_type* elem) { out[i] = iterator<OrderType>{elem}; });
+    }
+
+    bool contains(const_reference key) const { return find(key) != end(); }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const { return find(key) != end(); }
+
+    size_type count(const_reference key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> lower_bound(const_reference key) const { return lower_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> lower_bound(const K& key) const { return lower_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> upper_bound(const_reference key) const { return upper_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> upper_bound(const K& key) const { return upper_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const_reference key) const {
+        return equal_range_<OrderType>(key);
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const K& key) const {
+        return equal_range_<OrderType>(key);
+    }
+
+    // Lazy view over every element in OrderType order, valid as long as its iterators are.
+    template <typename OrderType = inorder_tag>
+    std::ranges::subrange<iterator<OrderType>> view() const { return {begin<OrderType>(), end<OrderType>()}; }
+
+    // Lazy view over the closed range [lo, hi], see range_view.
+    range_view<value_type> range(const_reference lo, const_reference hi) const {
+        return {this, iterator<>{lower_bound_node_(lo)}, hi};
+    }
+
+    template <typename K>
+    requires is_transparent_
+    range_view<std::decay_t<K>> range(const K& lo, const K& hi) const {
+        return {this, iterator<>{lower_bound_node_(lo)}, hi};
+    }
+
+    // Lazy view over the elements not less than key: keys_from(key) | std::views::take(n)
+    // costs one descent and n steps.
+    std::ranges::subrange<iterator<>> keys_from(const_reference key) const { return {lower_bound_<inorder_tag>(key), end()}; }
+
+    template <typename K>
+    requires is_transparent_
+    std::ranges::subrange<iterator<>> keys_from(const K& key) const { return {lower_bound_<inorder_tag>(key), end()}; }
+
+    // The k-th smallest element (0-based), end() when k >= size().
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> nth(size_type k) const requires counted_ {
+        node_type* now = fake_node_->left;
+        while (now != nullptr) {
+            size_type left = weight_of_(now->left);
+            if (k == left) {
+                return iterator<OrderType>(now);
+            }
+            now = (k < left) ? now->left : now->right;
+            k = (k < left) ? k : k - left - 1;
+        }
+        return end<OrderType>();
+    }
+
+    // Number of elements less than key.
+    size_type rank(const_reference key) const requires counted_ { return rank_<false>(key); }
+
+    template <typename K>
+    requires (counted_ && is_transparent_)
+    size_type rank(const K& key) const { return rank_<false>(key); }
+
+    // Number of elements in the closed range [lo, hi].
+    size_type count_range(const_reference lo, const_reference hi) const requires counted_ {
+        return count_range_(lo, hi);
+    }
+
+    template <typename K>
+    requires (counted_ && is_transparent_)
+    size_type count_range(const K& lo, const K& hi) const { return count_range_(lo, hi); }
+
+    // Augment::combine over every element, in order.
+    AggregateValue aggregate() const requires aggregated_ { return aggregate_of_(fake_node_->left); }
+
+    // Augment::combine over the elements of the closed range [lo, hi], in order.
+    AggregateValue aggregate(const_reference lo, const_reference hi) const requires aggregated_ {
+        return aggregate_(lo, hi);
+    }
+
+    template <typename K>
+    requires (aggregated_ && is_transparent_)
+    AggregateValue aggregate(const K& lo, const K& hi) const { return aggregate_(lo, hi); }
+
+    key_compare key_comp() const { return comp_; }
 
     value_compare value_comp() const { return comp_; }
 
     allocator_type get_allocator() const {return alloc_; }
 
+    // Read-optimized immutable copy; defined in lib/FrozenTree.cpp.
+    FrozenTree<T, Compare, Alloc> freeze() const {
+        return FrozenTree<T, Compare, Alloc>(sorted_unique_tag{}, begin(), end(), comp_);
+    }
+
+    // Counters since construction or reset_stats(); all zero unless BST_ENABLE_STATS is defined.
+    // A descent is one root-to-leaf search by insert, find, erase or a bound; its depth is the
+    // number of nodes it visits.
+    struct stats_type {
+        uint64_t comparisons = 0;
+        uint64_t allocations = 0;
+        uint64_t deallocations = 0;
+        uint64_t descents = 0;
+        uint64_t descent_steps = 0;
+        uint64_t max_descent = 0;
+    };
+
+    stats_type stats() const {
+        stats_type res;
+#ifdef BST_ENABLE_STATS
+        res.comparisons = comp_.calls.load(std::memory_order_relaxed);
+        res.allocations = counters_.allocations.load(std::memory_order_relaxed);
+        res.deallocations = counters_.deallocations.load(std::memory_order_relaxed);
+        res.descents = counters_.descents.load(std::memory_order_relaxed);
+        res.descent_steps = counters_.descent_steps.load(std::memory_order_relaxed);
+        res.max_descent = counters_.max_descent.load(std::memory_order_relaxed);
+#endif
+        return res;
+    }
+
+    void reset_stats() {
+#ifdef BST_ENABLE_STATS
+        comp_.calls.store(0, std::memory_order_relaxed);
+        counters_.allocations.store(0, std::memory_order_relaxed);
+        counters_.deallocations.store(0, std::memory_order_relaxed);
+        counters_.descents.store(0, std::memory_order_relaxed);
+        counters_.descent_steps.store(0, std::memory_order_relaxed);
+        counters_.max_descent.store(0, std::memory_order_relaxed);
+#endif
+    }
+
+    // Depth counts edges from the root, so height is the largest depth; a node's balance factor
+    // is height(left) - height(right) with empty subtrees at -1. O(n), without recursion.
+    struct shape_stats_type {
+        size_type size = 0;
+        size_type height = 0;
+        double average_depth = 0;
+        std::map<long, size_type> balance_factors;
+        size_type memory_bytes = 0;
+    };
+
+    shape_stats_type shape_stats() const {
+        shape_stats_type res;
+        res.size = size_;
+        res.memory_bytes = sizeof(*this) + size_ * sizeof(node_type);
+        // Height and size of the finished subtrees; postorder pops the children before the parent.
+        std::vector<std::pair<long, size_type>> done;
+        size_type total_depth = 0;
+        for (auto it = begin<postorder_tag>(); it != end<postorder_tag>(); ++it) {
+            node_type* elem = static_cast<node_type*>(it.ptr_);
+            std::pair<long, size_type> right{-1, 0};
+            std::pair<long, size_type> left{-1, 0};
+            if (elem->right != nullptr) {
+                right = done.back();
+                done.pop_back();
+            }
+            if (elem->left != nullptr) {
+                left = done.back();
+                done.pop_back();
+            }
+            ++res.balance_factors[left.first - right.first];
+            size_type count = 1 + left.second + right.second;
+            total_depth += count - 1;
+            done.emplace_back(1 + std::max(left.first, right.first), count);
+        }
+        if (!done.empty()) {
+            res.height = static_cast<size_type>(done.back().first);
+            res.average_depth = static_cast<double>(total_depth) / static_cast<double>(size_);
+        }
+        return res;
+    }
+
+private:
+    template <typename OrderType, typename K>
+    iterator<OrderType> find_(const K& key) const {
+        node_type* best = lower_bound_node_(key);
+        if (best != fake_node_ && !comp_(key, best->data_)) {
+            return iterator<OrderType>{best};
+        }
+        return end<OrderType>();
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> lower_bound_(const K& key) const { return iterator<OrderType>{lower_bound_node_(key)}; }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> upper_bound_(const K& key) const { return iterator<OrderType>{upper_bound_node_(key)}; }
+
+    // First node not less than key, or the fake node; one comparison per level.
+    template <typename K>
+    node_type* lower_bound_node_(const K& key) const {
+        node_type* now = fake_node_->left;
+        node_type* best = static_cast<node_type*>(fake_node_);
+        uint64_t depth = 0;
+        while (now != nullptr) {
+            bool go_right = comp_(now->data_, key);
+            best = go_right ? best : now;
+            now = go_right ? now->right : now->left;
+            ++depth;
+        }
+        note_descent_(depth);
+        return best;
+    }
+
+    // Both bounds share the path down to the first element equivalent to key; below it the
+    // lower bound is searched in its left subtree and the upper bound in its right one.
+    template <typename OrderType, typename K>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range_(const K& key) const {
+        node_type* now = fake_node_->left;
+        node_type* upper = static_cast<node_type*>(fake_node_);
+        uint64_t depth = 0;
+        while (now != nullptr) {
+            if (comp_(now->data_, key)) {
+                now = now->right;
+            } else if (comp_(key, now->data_)) {
+                upper = now;
+                now = now->left;
+            } else {
+                break;
+            }
+            ++depth;
+        }
+        if (now == nullptr) {
+            note_descent_(depth);
+            return {iterator<OrderType>{upper}, iterator<OrderType>{upper}};
+        }
+        node_type* lower = now;
+        for (node_type* left = now->left; left != nullptr; ++depth) {
+            bool go_right = comp_(left->data_, key);
+            lower = go_right ? lower : left;
+            left = go_right ? left->right : left->left;
+        }
+        for (node_type* right = now->right; right != nullptr; ++depth) {
+            bool go_left = comp_(key, right->data_);
+            upper = go_left ? right : upper;
+            right = go_left ? right->left : right->right;
+        }
+        note_descent_(depth);
+        return {iterator<OrderType>{lower}, iterator<OrderType>{upper}};
+    }
+
+    template <typename K>
+    node_type* upper_bound_node_(const K& key) const {
+        node_type* now = fake_node_->left;
+        node_type* best = static_cast<node_type*>(fake_node_);
+        uint64_t depth = 0;
+        while (now != nullptr) {
+            bool go_left = comp_(key, now->data_);
+            best = go_left ? now : best;
+            now = go_left ? now->left : now->right;
+            ++depth;
+        }
+        note_descent_(depth);
+        return best;
+    }
+
+    template <typename K>
+    decltype(auto) probe_(const K& key) const {
+        if constexpr (is_transparent_ || std::is_same_v<K, key_type>) {
+            return (key);
+        } else {
+            return key_type(key);
+        }
+    }
+
+    template <typename... Args>
+    node_type* create_node_(Args&&... args) {
+        node_type* val = alloc_.allocate(1);
+        AllocTraits::construct(alloc_, val, std::forward<Args>(args)...);
+        note_alloc_();
+        return val;
+    }
+
+    // Stats hooks; they compile to nothing without BST_ENABLE_STATS.
+    void note_alloc_() const {
+#ifdef BST_ENABLE_STATS
+        counters_.allocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    size_type note_free_(size_type count) const {
+#ifdef BST_ENABLE_STATS
+        counters_.deallocations.fetch_add(count, std::memory_order_relaxed);
+#endif
+        return count;
+    }
+
+    void note_descent_([[maybe_unused]] uint64_t depth) const {
+#ifdef BST_ENABLE_STATS
+        counters_.descents.fetch_add(1, std::memory_order_relaxed);
+        counters_.descent_steps.fetch_add(depth, std::memory_order_relaxed);
+        uint64_t seen = counters_.max_descent.load(std::memory_order_relaxed);
+        while (seen < depth && !counters_.max_descent.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+        }
+#endif
+    }
+
+    static size_type weight_of_(const BaseNode* elem) {
+        if constexpr (counted_) {
+            return (elem != nullptr) ? elem->weight_ : 0;
+        } else {
+            return 0;
+        }
+    }
+
+    // Inorder position of a node; the fake node (end) is at size().
+    static size_type index_(const BaseNode* elem) {
+        if (elem->parent == elem) {
+            return weight_of_(elem->left);
+        }
+        size_type index = weight_of_(elem->left);
+        for (const BaseNode* par = elem->parent; par->parent != par; elem = par, par = par->parent) {
+            index += (par->right == elem) ? weight_of_(par->left) + 1 : 0;
+        }
+        return index;
+    }
+
+    // Counts the elements less than key, or not greater than key when Inclusive.
+    template <bool Inclusive, typename K>
+    size_type rank_(const K& key) const {
+        size_type count = 0;
+        node_type* now = fake_node_->left;
+        while (now != nullptr) {
+            bool go_right = Inclusive ? !comp_(key, now->data_) : comp_(now->data_, key);
+            count += go_right ? weight_of_(now->left) + 1 : 0;
+            now = go_right ? now->right : now->left;
+        }
+        return count;
+    }
+
+    template <typename K>
+    size_type count_range_(const K& lo, const K& hi) const {
+        if (comp_(hi, lo)) {
+            return 0;
+        }
+        return rank_<true>(hi) - rank_<false>(lo);
+    }
+
+    static AggregateValue aggregate_of_(const node_type* elem) {
+        return (elem != nullptr) ? elem->aggregate_ : Augment::identity();
+    }
+
+    // The node where the paths to lo and hi split is in the range; below it, the left path adds
+    // every node >= lo with its right subtree and the right path every node <= hi with its left one.
+    template <typename K>
+    AggregateValue aggregate_(const K& lo, const K& hi) const {
+        if (comp_(hi, lo)) {
+            return Augment::identity();
+        }
+        node_type* split = fake_node_->left;
+        while (split != nullptr) {
+            if (comp_(split->data_, lo)) {
+                split = split->right;
+            } else if (comp_(hi, split->data_)) {
+                split = split->left;
+            } else {
+                break;
+            }
+        }
+        if (split == nullptr) {
+            return Augment::identity();
+        }
+        AggregateValue left = Augment::identity();
+        for (node_type* now = split->left; now != nullptr;) {
+            if (comp_(now->data_, lo)) {
+                now = now->right;
+            } else {
+                left = Augment::combine(Augment::combine(Augment::lift(now->data_), aggregate_of_(now->right)), left);
+                now = now->left;
+            }
+        }
+        AggregateValue right = Augment::identity();
+        for (node_type* now = split->right; now != nullptr;) {
+            if (comp_(hi, now->data_)) {
+                now = now->left;
+            } else {
+                right = Augment::combine(right, Augment::combine(aggregate_of_(now->left), Augment::lift(now->data_)));
+                now = now->right;
+            }
+        }
+        return Augment::combine(Augment::combine(left, Augment::lift(split->data_)), right);
+    }
+
+    // Recomputes the augmentation of elem from its children.
+    void pull_(node_type* elem) {
+        if constexpr (counted_) {
+            elem->weight_ = 1 + weight_of_(elem->left) + weight_of_(elem->right);
+        }
+        if constexpr (aggregated_) {
+            elem->aggregate_ = Augment::combine(Augment::combine(aggregate_of_(elem->left), Augment::lift(elem->data_)),
+                                                aggregate_of_(elem->right));
+        }
+    }
+
+    void pull_path_(node_type* elem) {
+        if constexpr (counted_) {
+            for (; elem != fake_node_; elem = elem->parent) {
+                pull_(elem);
+            }
+        }
+    }
+
+    void drop_node_(node_type* elem) {
+        AllocTraits::destroy(alloc_, elem);
+        alloc_.deallocate(elem, 1);
+        note_free_(1);
+    }
+
+    size_type free_subtree_(node_type* root) { return note_free_(destroy_subtree_(root, alloc_)); }
+
+    // Post-order walk that destroys each node of the subtree once. Parent links lead back up,
+    // so it needs no stack and never rebalances or relinks the nodes that are still alive.
+    template <bool Deallocate = true>
+    static size_type destroy_subtree_(node_type* root, NodeAlloc& alloc) {
+        node_type* now = root;
+        size_type count = 0;
+        while (true) {
+            if (now->left != nullptr) {
+                now = now->left;
+            } else if (now->right != nullptr) {
+                now = now->right;
+            } else {
+                node_type* par = now->parent;
+                bool last = (now == root);
+                if (!last) {
+                    (par->left == now ? par->left : par->right) = nullptr;
+                }
+                AllocTraits::destroy(alloc, now);
+                if constexpr (Deallocate) {
+                    alloc.deallocate(now, 1);
+                }
+                ++count;
+                if (last) {
+                    return count;
+                }
+                now = par;
+            }
+        }
+    }
+
+    void reset_() {
+        fake_node_->left = nullptr;
+        fake_node_->right = static_cast<node_type*>(fake_node_);
+        close_ring_();
+        size_ = 0;
+    }
+
+    // Join-based set algebra (Blelloch, Ferizovic, Sun, "Just Join for Parallel Ordered Sets").
+    // The helpers below work on detached subtrees: parent links inside a subtree are kept,
+    // the parent of its root is not, and adopt_ links the final root back under fake_node_.
+
+    bool same_pool_(const BinarySearchTree& other) const {
+        return AllocTraits::is_always_equal::value || alloc_ == other.alloc_;
+    }
+
+    void move_elements_(BinarySearchTree& other) {
+        for (auto it = other.begin(); it != other.end(); ++it) {
+            insert(std::move(static_cast<node_type*>(it.ptr_)->data_));
+        }
+        other.clear();
+    }
+
+    node_type* take_root_() {
+        node_type* root = fake_node_->left;
+        reset_();
+        return root;
+    }
+
+    // Threaded trees relink the whole inorder ring unless the caller splices it itself.
+    void adopt_(node_type* root, size_type count, bool rethread = true) {
+        if (root == nullptr) {
+            reset_();
+            return;
+        }
+        if constexpr (std::is_same_v<Balance, red_black_tag>) {
+            root->balance_ = 1;
+        }
+        root->parent = static_cast<node_type*>(fake_node_);
+        fake_node_->left = root;
+        fake_node_->right = leftmost_(root);
+        size_ = count;
+        if (rethread) {
+            thread_all_();
+        }
+    }
+
+    // First and last node of the ring, the fake node for an empty tree.
+    struct Ends {
+        node_type* first;
+        node_type* last;
+    };
+
+    Ends ends_() const {
+        if constexpr (threaded_) {
+            return {fake_node_->thread_.next, fake_node_->thread_.prev};
+        } else {
+            return {nullptr, nullptr};
+        }
+    }
+
+    static void chain_(node_type* left, node_type* right) {
+        if constexpr (threaded_) {
+            left->thread_.next = right;
+            right->thread_.prev = left;
+        }
+    }
+
+    void ring_(node_type* first, node_type* last) {
+        chain_(static_cast<node_type*>(fake_node_), first);
+        chain_(last, static_cast<node_type*>(fake_node_));
+    }
+
+    void close_ring_() { ring_(static_cast<node_type*>(fake_node_), static_cast<node_type*>(fake_node_)); }
+
+    // Links the ring in one inorder walk over the parent links.
+    void thread_all_() {
+        if constexpr (threaded_) {
+            node_type* fake = static_cast<node_type*>(fake_node_);
+            node_type* prev = fake;
+            node_type* now = (fake_node_->left != nullptr) ? leftmost_(fake_node_->left) : fake;
+            while (now != fake) {
+                chain_(prev, now);
+                prev = now;
+                if (now->right != nullptr) {
+                    now = leftmost_(now->right);
+                    continue;
+                }
+                node_type* par = now->parent;
+                while (par != now && now == par->right) {
+                    now = par;
+                    par = par->parent;
+                }
+                now = par;
+            }
+            chain_(prev, fake);
+        }
+    }
+
+    template <typename K>
+    BinarySearchTree split_tree_(const K& key) {
+        BinarySearchTree right;
+        right.alloc_ = alloc_;
+        right.comp_ = comp_;
+        size_type total = size_;
+        Ends ends = ends_();
+        node_type* cut = threaded_ ? lower_bound_node_(key) : nullptr;
+        Split parts = split_(take_root_(), key);
+        if (parts.found != nullptr) {
+            parts.right = join_(Balance{}, nullptr, parts.found, parts.right);
+        }
+        right.adopt_(parts.right, weight_of_(parts.right), false);
+        if constexpr (threaded_) {
+            if (cut != fake_node_) {
+                node_type* before = cut->thread_.prev;
+                right.ring_(cut, ends.last);
+                ends.last = before;
+            }
+        }
+        adopt_(parts.left, total - right.size_, false);
+        if constexpr (threaded_) {
+            if (parts.left != nullptr) {
+                ring_(ends.first, ends.last);
+            }
+        }
+        return right;
+    }
+
+    // Links left and right under elem as they are; the caller keeps the policy invariants.
+    node_type* link_(node_type* left, node_type* elem, node_type* right) {
+        elem->left = left;
+        elem->right = right;
+        if (left != nullptr) {
+            left->parent = elem;
+        }
+        if (right != nullptr) {
+            right->parent = elem;
+        }
+        recalc_(Balance{}, elem);
+        pull_(elem);
+        return elem;
+    }
+
+    node_type* rotate_left_detached_(node_type* elem) {
+        node_type* sub = elem->right;
+        return link_(link_(elem->left, elem, sub->left), sub, sub->right);
+    }
+
+    node_type* rotate_right_detached_(node_type* elem) {
+        node_type* sub = elem->left;
+        return link_(sub->left, sub, link_(sub->right, elem, elem->right));
+    }
+
+    // join_(left, elem, right): every key of left < elem < every key of right.
+    node_type* join_(unbalanced_tag, node_type* left, node_type* elem, node_type* right) {
+        return link_(left, elem, right);
+    }
+
+    node_type* join_(avl_tag, node_type* left, node_type* elem, node_type* right) {
+        if (height_(left) > height_(right) + 1) {
+            return join_right_avl_(left, elem, right);
+        }
+        if (height_(right) > height_(left) + 1) {
+            return join_left_avl_(left, elem, right);
+        }
+        return link_(left, elem, right);
+    }
+
+    // Walks down the right spine of the taller left tree to a subtree as high as right.
+    node_type* join_right_avl_(node_type* left, node_type* elem, node_type* right) {
+        node_type* inner = left->right;
+        if (height_(inner) <= height_(right) + 1) {
+            node_type* sub = link_(inner, elem, right);
+            if (height_(sub) <= height_(left->left) + 1) {
+                return link_(left->left, left, sub);
+            }
+            return rotate_left_detached_(link_(left->left, left, rotate_right_detached_(sub)));
+        }
+        node_type* sub = join_right_avl_(inner, elem, right);
+        bool balanced = height_(sub) <= height_(left->left) + 1;
+        node_type* res = link_(left->left, left, sub);
+        return balanced ? res : rotate_left_detached_(res);
+    }
+
+    node_type* join_left_avl_(node_type* left, node_type* elem, node_type* right) {
+        node_type* inner = right->left;
+        if (height_(inner) <= height_(left) + 1) {
+            node_type* sub = link_(left, elem, inner);
+            if (height_(sub) <= height_(right->right) + 1) {
+                return link_(sub, right, right->right);
+            }
+            return rotate_right_detached_(link_(rotate_left_detached_(sub), right, right->right));
+        }
+        node_type* sub = join_left_avl_(left, elem, inner);
+        bool balanced = height_(sub) <= height_(right->right) + 1;
+        node_type* res = link_(sub, right, right->right);
+        return balanced ? res : rotate_right_detached_(res);
+    }
+
+    static int black_height_(const node_type* elem) {
+        int height = 0;
+        for (; elem != nullptr; elem = elem->left) {
+            height += elem->balance_;
+        }
+        return height;
+    }
+
+    // Both roots are blackened first, so the red elem placed between two black subtrees
+    // can only clash with its new parent; the spine walk repairs that with one rotation.
+    node_type* join_(red_black_tag, node_type* left, node_type* elem, node_type* right) {
+        if (left != nullptr) {
+            left->balance_ = 1;
+        }
+        if (right != nullptr) {
+            right->balance_ = 1;
+        }
+        int left_height = black_height_(left);
+        int right_height = black_height_(right);
+        if (left_height > right_height) {
+            node_type* res = join_right_rb_(left, left_height, elem, right_height, right);
+            if (is_red_(res) && is_red_(res->right)) {
+                res->balance_ = 1;
+            }
+            return res;
+        }
+        if (left_height < right_height) {
+            node_type* res = join_left_rb_(left, left_height, elem, right_height, right);
+            if (is_red_(res) && is_red_(res->left)) {
+                res->balance_ = 1;
+            }
+            return res;
+        }
+        elem->balance_ = 0;
+        return link_(left, elem, right);
+    }
+
+    node_type* join_right_rb_(node_type* left, int left_height, node_type* elem, int right_height, node_type* right) {
+        if (!is_red_(left) && left_height == right_height) {
+            elem->balance_ = 0;
+            return link_(left, elem, right);
+        }
+        int inner_height = left_height - left->balance_;
+        node_type* sub = join_right_rb_(left->right, inner_height, elem, right_height, right);
+        node_type* res = link_(left->left, left, sub);
+        if (!is_red_(left) && is_red_(sub) && is_red_(sub->right)) {
+            sub->right->balance_ = 1;
+            return rotate_left_detached_(res);
+        }
+        return res;
+    }
+
+    node_type* join_left_rb_(node_type* left, int left_height, node_type* elem, int right_height, node_type* right) {
+        if (!is_red_(right) && left_height == right_height) {
+            elem->balance_ = 0;
+            return link_(left, elem, right);
+        }
+        int inner_height = right_height - right->balance_;
+        node_type* sub = join_left_rb_(left, left_height, elem, inner_height, right->left);
+        node_type* res = link_(sub, right, right->right);
+        if (!is_red_(right) && is_red_(sub) && is_red_(sub->left)) {
+            sub->left->balance_ = 1;
+            return rotate_right_detached_(res);
+        }
+        return res;
+    }
+
+    // Joins two subtrees without a middle element by lifting out the maximum of left.
+    node_type* join2_(node_type* left, node_type* right) {
+        if (left == nullptr) {
+            return right;
+        }
+        node_type* last = left;
+        while (last->right != nullptr) {
+            last = last->right;
+        }
+        // Joining may relink a node under a new parent, so the next one up is read beforehand.
+        node_type* rest = last->left;
+        node_type* par = (last != left) ? last->parent : nullptr;
+        while (par != nullptr) {
+            node_type* up = (par != left) ? par->parent : nullptr;
+            rest = join_(Balance{}, par->left, par, rest);
+            par = up;
+        }
+        return join_(Balance{}, rest, last, right);
+    }
+
+    struct Split {
+        node_type* left;
+        node_type* found;
+        node_type* right;
+    };
+
+    // Splits the subtree by key without recursion: after the descent, the nodes of the search
+    // path are joined bottom-up onto the left or the right part. found is detached when present.
+    template <typename K>
+    Split split_(node_type* root, const K& key) {
+        Split parts{nullptr, nullptr, nullptr};
+        node_type* now = root;
+        node_type* last = nullptr;
+        bool went_left = false;
+        while (now != nullptr) {
+            last = now;
+            went_left = comp_(key, now->data_);
+            if (!went_left && !comp_(now->data_, key)) {
+                parts.found = now;
+                break;
+            }
+            now = went_left ? now->left : now->right;
+        }
+        node_type* child = nullptr;
+        if (parts.found != nullptr) {
+            parts.left = parts.found->left;
+            parts.right = parts.found->right;
+            child = parts.found;
+            if (parts.found == root) {
+                return parts;
+            }
+            last = parts.found->parent;
+        }
+        for (node_type* now = last; now != nullptr;) {
+            node_type* up = (now == root) ? nullptr : now->parent;
+            bool left_turn = (child == nullptr) ? went_left : (now->left == child);
+            if (left_turn) {
+                parts.right = join_(Balance{}, parts.right, now, now->right);
+            } else {
+                parts.left = join_(Balance{}, now->left, now, parts.left);
+            }
+            child = now;
+            now = up;
+        }
+        return parts;
+    }
+
+    void merge_(BinarySearchTree& source, int forks) {
+        size_type count = size_ + source.size_;
+        size_type kept = 0;
+        node_type* rest = nullptr;
+        node_type* root = union_(take_root_(), source.take_root_(), rest, kept, forks);
+        adopt_(root, count - kept);
+        source.adopt_(rest, kept);
+    }
+
+    void set_union_(BinarySearchTree& other, int forks) {
+        size_type count = size_ + other.size_;
+        size_type dropped = 0;
+        node_type* dups = nullptr;
+        node_type* root = union_(take_root_(), other.take_root_(), dups, dropped, forks);
+        if (dups != nullptr) {
+            free_subtree_(dups);
+        }
+        adopt_(root, count - dropped);
+    }
+
+    void set_intersection_(BinarySearchTree& other, int forks) {
+        size_type count = size_ + other.size_;
+        size_type dropped = 0;
+        node_type* root = intersection_(take_root_(), other.take_root_(), dropped, forks);
+        adopt_(root, count - dropped);
+    }
+
+    void set_difference_(BinarySearchTree& other, int forks) {
+        size_type count = size_ + other.size_;
+        size_type dropped = 0;
+        node_type* root = difference_(take_root_(), other.take_root_(), dropped, forks);
+        adopt_(root, count - dropped);
+    }
+
+    // Forking starts at kParallelGrain elements and goes a few levels deeper than needed to
+    // give every hardware thread a subtree, so that uneven subtrees still balance out.
+    static constexpr size_type kParallelGrain = 4096;
+
+    static int fork_depth_(size_type count) {
+        if (count < kParallelGrain) {
+            return 0;
+        }
+        return std::bit_width(std::max(1u, std::thread::hardware_concurrency())) + 1;
+    }
+
+    // Runs left on a new thread and right on this one while forks remain, otherwise both here.
+    template <typename Left, typename Right>
+    static void fork_(int forks, Left&& left, Right&& right) {
+        if (forks <= 0) {
+            left();
+            right();
+            return;
+        }
+        std::future<void> task = std::async(std::launch::async, std::forward<Left>(left));
+        right();
+        task.get();
+    }
+
+    static int full_depth_(size_type count) {
+        int depth = 0;
+        while ((size_type{2} << depth) <= count) {
+            ++depth;
+        }
+        return depth;
+    }
+
+    template <typename It>
+    node_type* build_parallel_(It first, size_type count, int depth, int max_depth, int forks) {
+        if (count == 0) {
+            return nullptr;
+        }
+        size_type left_count = count / 2;
+        node_type* elem = create_node_(first[left_count]);
+        node_type* left;
+        node_type* right;
+        fork_((count >= kParallelGrain) ? forks : 0,
+              [&] { left = build_parallel_(first, left_count, depth + 1, max_depth, forks - 1); },
+              [&] { right = build_parallel_(first + left_count + 1, count - left_count - 1, depth + 1, max_depth, forks - 1); });
+        link_(left, elem, right);
+        settle_(Balance{}, elem, depth, max_depth);
+        return elem;
+    }
+
+    static node_type* rightmost_(node_type* elem) {
+        while (elem->right != nullptr) {
+            elem = elem->right;
+        }
+        return elem;
+    }
+
+    template <typename F>
+    static void for_each_(node_type* elem, F& f, int forks) {
+        if (forks <= 0) {
+            iterator<> last(rightmost_(elem));
+            for (iterator<> it(leftmost_(elem)); it != last; ++it) {
+                f(*it);
+            }
+            f(*last);
+            return;
+        }
+        fork_(forks,
+              [&] {
+                  if (elem->left != nullptr) {
+                      for_each_(elem->left, f, forks - 1);
+                  }
+              },
+              [&] {
+                  f(static_cast<const T&>(elem->data_));
+                  if (elem->right != nullptr) {
+                      for_each_(elem->right, f, forks - 1);
+                  }
+              });
+    }
+
+    template <typename U, typename BinaryOp>
+    static U reduce_(node_type* elem, BinaryOp& op, int forks) {
+        if (forks <= 0) {
+            iterator<> last(rightmost_(elem));
+            iterator<> it(leftmost_(elem));
+            U acc = U(*it);
+            while (it != last) {
+                ++it;
+                acc = op(std::move(acc), *it);
+            }
+            return acc;
+        }
+        std::optional<U> left;
+        std::optional<U> right;
+        fork_(forks,
+              [&] {
+                  if (elem->left != nullptr) {
+                      left.emplace(reduce_<U>(elem->left, op, forks - 1));
+                  }
+              },
+              [&] {
+                  if (elem->right != nullptr) {
+                      right.emplace(reduce_<U>(elem->right, op, forks - 1));
+                  }
+              });
+        U acc = left ? op(std::move(*left), static_cast<const T&>(elem->data_)) : U(elem->data_);
+        return right ? op(std::move(acc), std::move(*right)) : acc;
+    }
+
+    // Recursion follows the shape of first, so depth is its height. Nodes of second equivalent
+    // to nodes of first are collected, in order, into the tree dups; dup_count counts them.
+    // Both recursive calls touch disjoint subtrees, so they can run on different threads.
+    node_type* union_(node_type* first, node_type* second, node_type*& dups, size_type& dup_count, int forks) {
+        dups = nullptr;
+        if (first == nullptr) {
+            return second;
+        }
+        if (second == nullptr) {
+            return first;
+        }
+        node_type* first_left = first->left;
+        node_type* first_right = first->right;
+        Split parts = split_(second, first->data_);
+        node_type* left;
+        node_type* right;
+        node_type* left_dups;
+        node_type* right_dups;
+        size_type left_count = 0;
+        fork_(forks,
+              [&] { left = union_(first_left, parts.left, left_dups, left_count, forks - 1); },
+              [&] { right = union_(first_right, parts.right, right_dups, dup_count, forks - 1); });
+        dup_count += left_count;
+        if (parts.found != nullptr) {
+            dups = join_(Balance{}, left_dups, parts.found, right_dups);
+            ++dup_count;
+        } else {
+            dups = join2_(left_dups, right_dups);
+        }
+        return join_(Balance{}, left, first, right);
+    }
+
+    node_type* intersection_(node_type* first, node_type* second, size_type& dropped, int forks) {
+        if (first == nullptr || second == nullptr) {
+            dropped += (first != nullptr) ? free_subtree_(first) : 0;
+            dropped += (second != nullptr) ? free_subtree_(second) : 0;
+            return nullptr;
+        }
+        node_type* first_left = first->left;
+        node_type* first_right = first->right;
+        Split parts = split_(second, first->data_);
+        node_type* left;
+        node_type* right;
+        size_type left_dropped = 0;
+        fork_(forks,
+              [&] { left = intersection_(first_left, parts.left, left_dropped, forks - 1); },
+              [&] { right = intersection_(first_right, parts.right, dropped, forks - 1); });
+        dropped += left_dropped + 1;
+        if (parts.found != nullptr) {
+            drop_node_(parts.found);
+            return join_(Balance{}, left, first, right);
+        }
+        drop_node_(first);
+        return join2_(left, right);
+    }
+
+    // Elements of first without an equivalent in second; recursion follows the shape of second.
+    node_type* difference_(node_type* first, node_type* second, size_type& dropped, int forks) {
+        if (first == nullptr || second == nullptr) {
+            dropped += (second != nullptr) ? free_subtree_(second) : 0;
+            return first;
+        }
+        node_type* second_left = second->left;
+        node_type* second_right = second->right;
+        Split parts = split_(first, second->data_);
+        node_type* left;
+        node_type* right;
+        size_type left_dropped = 0;
+        fork_(forks,
+              [&] { left = difference_(parts.left, second_left, left_dropped, forks - 1); },
+              [&] { right = difference_(parts.right, second_right, dropped, forks - 1); });
+        drop_node_(second);
+        dropped += left_dropped + 1;
+        if (parts.found != nullptr) {
+            drop_node_(parts.found);
+            ++dropped;
+        }
+        return join2_(left, right);
+    }
+
+    // Equivalent node if found, otherwise the parent of the empty slot where the key belongs.
+    struct Position {
+        node_type* node;
+        bool to_left;
+        bool found;
+    };
+
+    // The last node where the descent turned right is the only candidate for an equivalent key.
+    // A descent from start must only be asked for keys whose position lies in start's subtree.
+    template <typename K>
+    Position locate_(const K& key) const { return locate_(key, fake_node_->left); }
+
+    template <typename K>
+    Position locate_(const K& key, node_type* start) const {
+        node_type* now = start;
+        node_type* par = static_cast<node_type*>(fake_node_);
+        node_type* candidate = nullptr;
+        bool to_left = true;
+        uint64_t depth = 0;
+        while (now != nullptr) {
+            par = now;
+            to_left = comp_(key, now->data_);
+            candidate = to_left ? candidate : now;
+            now = to_left ? now->left : now->right;
+            ++depth;
+        }
+        note_descent_(depth);
+        if (candidate != nullptr && !comp_(candidate->data_, key)) {
+            return {candidate, false, true};
+        }
+        return {par, to_left, false};
+    }
+
+    template <typename OrderType, typename K, typename... Args>
+    std::pair<iterator<OrderType>, bool> emplace_at_(const K& key, Args&&... args) {
+        Position pos = locate_(probe_(key));
+        if (pos.found) {
+            return std::pair(iterator<OrderType>{pos.node}, false);
+        }
+        node_type* val = create_node_(std::forward<Args>(args)...);
+        attach_(pos.node, pos.to_left, val);
+        return std::pair(iterator<OrderType>{val}, true);
+    }
+
+    // Climbs from finger to the lowest ancestor whose subtree must hold key's position: going
+    // towards key, stop at the first edge that turns back past it.
+    template <typename K>
+    node_type* finger_root_(node_type* finger, const K& key) const {
+        if (finger == fake_node_) {
+            return fake_node_->left;
+        }
+        bool rightwards = comp_(finger->data_, key);
+        if (!rightwards && !comp_(key, finger->data_)) {
+            return finger;
+        }
+        node_type* now = finger;
+        while (now->parent != fake_node_) {
+            node_type* par = now->parent;
+            if (rightwards ? (par->left == now && comp_(key, par->data_))
+                           : (par->right == now && comp_(par->data_, key))) {
+                break;
+            }
+            now = par;
+        }
+        return now;
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> find_from_(node_type* finger, const K& key) const {
+        Position pos = locate_(key, finger_root_(finger, key));
+        return pos.found ? iterator<OrderType>{pos.node} : end<OrderType>();
+    }
+
+    static void prefetch_(const node_type* elem) {
+#if defined(__GNUC__)
+        __builtin_prefetch(elem);
+#endif
+    }
+
+    // Follows the descent that every key in [lo, hi] shares; returns where they part and the
+    // lower bound found on the way.
+    template <typename K>
+    std::pair<node_type*, node_type*> shared_path_(const K& lo, const K& hi) const {
+        node_type* now = fake_node_->left;
+        node_type* best = static_cast<node_type*>(fake_node_);
+        while (now != nullptr) {
+            if (comp_(now->data_, lo)) {
+                now = now->right;
+            } else if (!comp_(now->data_, hi)) {
+                best = now;
+                now = now->left;
+            } else {
+                break;
+            }
+        }
+        return {now, best};
+    }
+
+    // Descents advanced together by batched lookups.
+    static constexpr size_type kBatchGroup = 16;
+
+    // Calls emit(i, lower bound of keys[i]).
+    template <typename K, typename Emit>
+    void batch_(std::span<const K> keys, Emit&& emit) const {
+        node_type* fake = static_cast<node_type*>(fake_node_);
+        bool sorted = std::is_sorted(keys.begin(), keys.end(), std::cref(comp_));
+        node_type* now[kBatchGroup];
+        node_type* best[kBatchGroup];
+        for (size_type base = 0; base < keys.size(); base += kBatchGroup) {
+            size_type width = std::min(kBatchGroup, keys.size() - base);
+            node_type* start = fake_node_->left;
+            node_type* bound = fake;
+            if (sorted) {
+                auto shared = shared_path_(keys[base], keys[base + width - 1]);
+                start = shared.first;
+                bound = shared.second;
+            }
+            for (size_type j = 0; j < width; ++j) {
+                now[j] = start;
+                best[j] = bound;
+            }
+            bool active = start != nullptr;
+            while (active) {
+                active = false;
+                for (size_type j = 0; j < width; ++j) {
+                    if (now[j] == nullptr) {
+                        continue;
+                    }
+                    bool go_right = comp_(now[j]->data_, keys[base + j]);
+                    best[j] = go_right ? best[j] : now[j];
+                    now[j] = go_right ? now[j]->right : now[j]->left;
+                    if (now[j] != nullptr) {
+                        prefetch_(now[j]);
+                        active = true;
+                    }
+                }
+            }
+            for (size_type j = 0; j < width; ++j) {
+                emit(base + j, best[j]);
+            }
+        }
+    }
+
+    template <typename OrderType, typename K>
+    void find_batch_(std::span<const K> keys, std::span<iterator<OrderType>> out) const {
+        batch_(keys, [&](size_type i, node_type* elem) {
+            bool hit = elem != fake_node_ && !comp_(keys[i], elem->data_);
+            out[i] = hit ? iterator<OrderType>{elem} : end<OrderType>();
+        });
+    }
+
+    // Checks whether key belongs right before or right after near, where the free slot is
+    // next to near or to its neighbour; otherwise searches from near as a finger.
+    template <typename K>
+    Position locate_near_(node_type* near, const K& key) const {
+        if (size_ == 0) {
+            return locate_(key);
+        }
+        if (near == fake_node_ || comp_(key, near->data_)) {
+            if (near == fake_node_->right) {
+                return {near, true, false};
+            }
+            iterator<> before_it{near};
+            node_type* before = static_cast<node_type*>((--before_it).ptr_);
+            if (comp_(before->data_, key)) {
+                return (near != fake_node_ && near->left == nullptr) ? Position{near, true, false}
+                                                                     : Position{before, false, false};
+            }
+        } else if (comp_(near->data_, key)) {
+            iterator<> after_it{near};
+            node_type* after = static_cast<node_type*>((++after_it).ptr_);
+            if (after == fake_node_ || comp_(key, after->data_)) {
+                return (near->right == nullptr) ? Position{near, false, false} : Position{after, true, false};
+            }
+        } else {
+            return {near, false, true};
+        }
+        return locate_(key, finger_root_(near, key));
+    }
+
+    template <typename K, typename... Args>
+    iterator<> emplace_near_(node_type* near, const K& key, Args&&... args) {
+        Position pos = locate_near_(near, probe_(key));
+        if (pos.found) {
+            return iterator<>{pos.node};
+        }
+        node_type* val = create_node_(std::forward<Args>(args)...);
+        attach_(pos.node, pos.to_left, val);
+        return iterator<>{val};
+    }
+
+    template <typename OrderType>
+    std::pair<iterator<OrderType>, bool> insert_node_(node_type* val) {
+        Position pos = locate_(val->data_);
+        if (pos.found) {
+            return std::pair(iterator<OrderType>{pos.node}, false);
+        }
+        attach_(pos.node, pos.to_left, val);
+        return std::pair(iterator<OrderType>{val}, true);
+    }
+
+    void steal_(BinarySearchTree& other) {
+        if (other.fake_node_->left == nullptr) {
+            return;
+        }
+        fake_node_->left = other.fake_node_->left;
+        fake_node_->left->parent = static_cast<node_type*>(fake_node_);
+        fake_node_->right = other.fake_node_->right;
+        size_ = other.size_;
+        if constexpr (threaded_) {
+            Ends ends = other.ends_();
+            ring_(ends.first, ends.last);
+        }
+        other.reset_();
+    }
+
+    static node_type* leftmost_(node_type* elem) {
+        while (elem->left != nullptr) {
+            elem = elem->left;
+        }
+        return elem;
+    }
+
+    void clone_(const BinarySearchTree& other) {
+        const node_type* src = other.fake_node_->left;
+        if (src == nullptr) {
+            return;
+        }
+        node_type* dst = create_node_(src->data_);
+        dst->balance_ = src->balance_;
+        dst->weight_ = src->weight_;
+        dst->aggregate_ = src->aggregate_;
+        dst->parent = static_cast<node_type*>(fake_node_);
+        fake_node_->left = dst;
+        while (true) {
+            if (src->left != nullptr && dst->left == nullptr) {
+                src = src->left;
+                dst->left = create_node_(src->data_);
+                dst->left->parent = dst;
+                dst = dst->left;
+            } else if (src->right != nullptr && dst->right == nullptr) {
+                src = src->right;
+                dst->right = create_node_(src->data_);
+                dst->right->parent = dst;
+                dst = dst->right;
+            } else if (src == other.fake_node_->left) {
+                break;
+            } else {
+                src = src->parent;
+                dst = dst->parent;
+                continue;
+            }
+            dst->balance_ = src->balance_;
+            dst->weight_ = src->weight_;
+            dst->aggregate_ = src->aggregate_;
+        }
+        fake_node_->right = leftmost_(fake_node_->left);
+        size_ = other.size_;
+        thread_all_();
+    }
+
+    template <typename It>
+    node_type* build_(It& first, size_type count, int depth, int max_depth, node_type* par) {
+        if (count == 0) {
+            return nullptr;
+        }
+        size_type left_count = count / 2;
+        node_type* left = build_(first, left_count, depth + 1, max_depth, nullptr);
+        node_type* elem = create_node_(*first);
+        ++first;
+        elem->parent = par;
+        elem->left = left;
+        if (left != nullptr) {
+            left->parent = elem;
+        }
+        elem->right = build_(first, count - left_count - 1, depth + 1, max_depth, elem);
+        settle_(Balance{}, elem, depth, max_depth);
+        pull_(elem);
+        return elem;
+    }
+
+    void settle_(red_black_tag, node_type* elem, int depth, int max_depth) {
+        elem->balance_ = (depth == max_depth && depth > 0) ? 0 : 1;
+    }
+
+    void settle_(avl_tag, node_type* elem, int, int) { recalc_(avl_tag{}, elem); }
+
+    void settle_(unbalanced_tag, node_type*, int, int) {}
+
+    static bool is_red_(const node_type* elem) { return elem != nullptr && elem->balance_ == 0; }
+
+    static signed char height_(const node_type* elem) { return (elem != nullptr) ? elem->balance_ : -1; }
+
+    void recalc_(red_black_tag, node_type*) {}
+
+    void recalc_(avl_tag, node_type* elem) {
+        elem->balance_ = 1 + std::max(height_(elem->left), height_(elem->right));
+    }
+
+    void recalc_(unbalanced_tag, node_type*) {}
+
+    void replace_child_(node_type* par, node_type* old_child, node_type* new_child) {
+        if (par == fake_node_) {
+            fake_node_->left = new_child;
+        } else if (par->left == old_child) {
+            par->left = new_child;
+        } else {
+            par->right = new_child;
+        }
+        if (new_child != nullptr) {
+            new_child->parent = par;
+        }
+    }
+
+    node_type* rotate_left_(node_type* elem) {
+        node_type* sub = elem->right;
+        elem->right = sub->left;
+        if (sub->left != nullptr) {
+            sub->left->parent = elem;
+        }
+        replace_child_(elem->parent, elem, sub);
+        sub->left = elem;
+        elem->parent = sub;
+        recalc_(Balance{}, elem);
+        recalc_(Balance{}, sub);
+        pull_(elem);
+        pull_(sub);
+        return sub;
+    }
+
+    node_type* rotate_right_(node_type* elem) {
+        node_type* sub = elem->left;
+        elem->left = sub->right;
+        if (sub->right != nullptr) {
+            sub->right->parent = elem;
+        }
+        replace_child_(elem->parent, elem, sub);
+        sub->right = elem;
+        elem->parent = sub;
+        recalc_(Balance{}, elem);
+        recalc_(Balance{}, sub);
+        pull_(elem);
+        pull_(sub);
+        return sub;
+    }
+
+    void attach_(node_type* par, bool to_left, node_type* val) {
+        val->left = nullptr;
+        val->right = nullptr;
+        val->balance_ = 0;
+        if constexpr (threaded_) {
+            node_type* before = to_left ? par->thread_.prev : par;
+            chain_(val, to_left ? par : par->thread_.next);
+            chain_(before, val);
+        }
+        if (par == fake_node_) {
+            fake_node_->left = val;
+            fake_node_->right = val;
+        } else if (to_left) {
+            par->left = val;
+            if (fake_node_->right == par) {
+                fake_node_->right = val;
+            }
+        } else {
+            par->right = val;
+        }
+        val->parent = par;
+        ++size_;
+        pull_path_(val);
+        insert_fixup_(Balance{}, val);
+    }
+
+    void insert_fixup_(red_black_tag, node_type* elem) {
+        while (elem != fake_node_->left && is_red_(elem->parent)) {
+            node_type* par = elem->parent;
+            node_type* grand = par->parent;
+            if (par == grand->left) {
+                node_type* uncle = grand->right;
+                if (is_red_(uncle)) {
+                    par->balance_ = 1;
+                    uncle->balance_ = 1;
+                    grand->balance_ = 0;
+                    elem = grand;
+                    continue;
+                }
+                if (elem == par->right) {
+                    elem = par;
+                    rotate_left_(elem);
+                    par = elem->parent;
+                }
+                par->balance_ = 1;
+                grand->balance_ = 0;
+                rotate_right_(grand);
+            } else {
+                node_type* uncle = grand->left;
+                if (is_red_(uncle)) {
+                    par->balance_ = 1;
+                    uncle->balance_ = 1;
+                    grand->balance_ = 0;
+                    elem = grand;
+                    continue;
+                }
+                if (elem == par->left) {
+                    elem = par;
+                    rotate_right_(elem);
+                    par = elem->parent;
+                }
+                par->balance_ = 1;
+                grand->balance_ = 0;
+                rotate_left_(grand);
+            }
+        }
+        fake_node_->left->balance_ = 1;
+    }
+
+    void insert_fixup_(avl_tag, node_type* elem) { retrace_avl_(elem->parent); }
+
+    void insert_fixup_(unbalanced_tag, node_type*) {}
+
+    void retrace_avl_(node_type* elem) {
+        while (elem != fake_node_) {
+            recalc_(avl_tag{}, elem);
+            int diff = height_(elem->left) - height_(elem->right);
+            if (diff > 1) {
+                if (height_(elem->left->left) < height_(elem->left->right)) {
+                    rotate_left_(elem->left);
+                }
+                elem = rotate_right_(elem);
+            } else if (diff < -1) {
+                if (height_(elem->right->right) < height_(elem->right->left)) {
+                    rotate_right_(elem->right);
+                }
+                elem = rotate_left_(elem);
+            }
+            elem = elem->parent;
+        }
+    }
+
+    void detach_(node_type* elem) {
+        if (fake_node_->right == elem) {
+            iterator<inorder_tag> next{elem};
+            ++next;
+            fake_node_->right = static_cast<node_type*>(next.ptr_);
+        }
+        node_type* child;
+        node_type* child_par;
+        if (elem->left == nullptr || elem->right == nullptr) {
+            child = (elem->left != nullptr) ? elem->left : elem->right;
+            child_par = elem->parent;
+            replace_child_(elem->parent, elem, child);
+        } else {
+            node_type* next = elem->right;
+            while (next->left != nullptr) {
+                next = next->left;
+            }
+            child = next->right;
+            if (next->parent == elem) {
+                child_par = next;
+            } else {
+                child_par = next->parent;
+                replace_child_(next->parent, next, child);
+                next->right = elem->right;
+                next->right->parent = next;
+            }
+            replace_child_(elem->parent, elem, next);
+            next->left = elem->left;
+            next->left->parent = next;
+            std::swap(next->balance_, elem->balance_);
+        }
+        --size_;
+        if constexpr (threaded_) {
+            chain_(elem->thread_.prev, elem->thread_.next);
+        }
+        pull_path_(child_par);
+        erase_fixup_(Balance{}, elem, child, child_par);
+    }
+
+    void erase_fixup_(red_black_tag, node_type* removed, node_type* elem, node_type* par) {
+        if (is_red_(removed)) {
+            return;
+        }
+        while (elem != fake_node_->left && !is_red_(elem)) {
+            if (elem == par->left) {
+                node_type* sibling = par->right;
+                if (is_red_(sibling)) {
+                    sibling->balance_ = 1;
+                    par->balance_ = 0;
+                    rotate_left_(par);
+                    sibling = par->right;
+                }
+                if (!is_red_(sibling->left) && !is_red_(sibling->right)) {
+                    sibling->balance_ = 0;
+                    elem = par;
+                    par = par->parent;
+                    continue;
+                }
+                if (!is_red_(sibling->right)) {
+                    sibling->left->balance_ = 1;
+                    sibling->balance_ = 0;
+                    rotate_right_(sibling);
+                    sibling = par->right;
+                }
+                sibling->balance_ = par->balance_;
+                par->balance_ = 1;
+                sibling->right->balance_ = 1;
+                rotate_left_(par);
+                elem = fake_node_->left;
+            } else {
+                node_type* sibling = par->left;
+                if (is_red_(sibling)) {
+                    sibling->balance_ = 1;
+                    par->balance_ = 0;
+                    rotate_right_(par);
+                    sibling = par->left;
+                }
+                if (!is_red_(sibling->left) && !is_red_(sibling->right)) {
+                    sibling->balance_ = 0;
+                    elem = par;
+                    par = par->parent;
+                    continue;
+                }
+                if (!is_red_(sibling->left)) {
+                    sibling->right->balance_ = 1;
+                    sibling->balance_ = 0;
+                    rotate_left_(sibling);
+                    sibling = par->left;
+                }
+                sibling->balance_ = par->balance_;
+                par->balance_ = 1;
+                sibling->left->balance_ = 1;
+                rotate_right_(par);
+                elem = fake_node_->left;
+            }
+        }
+        if (elem != nullptr) {
+            elem->balance_ = 1;
+        }
+    }
+
+    void erase_fixup_(avl_tag, node_type*, node_type*, node_type* par) { retrace_avl_(par); }
+
+    void erase_fixup_(unbalanced_tag, node_type*, node_type*, node_type*) {}
 };
 
-template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
-bool operator==(const BinarySearchTree<T, Compare, Alloc>& first, 
-                const BinarySearchTree<T, Compare, Alloc>& second) {
+template <typename T, typename Compare, typename Alloc, typename Balance, typename Augment, typename Threading>
+bool operator==(const BinarySearchTree<T, Compare, Alloc, Balance, Augment, Threading>& first, 
+                const BinarySearchTree<T, Compare, Alloc, Balance, Augment, Threading>& second) {
     return (std::equal(first.begin(), first.end(), second.begin(), second.end())) ? true : false;
 }
 
-template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
-bool operator!=(const BinarySearchTree<T, Compare, Alloc>& first, 
-                const BinarySearchTree<T, Compare, Alloc>& second) { 
+template <typename T, typename Compare, typename Alloc, typename Balance, typename Augment, typename Threading>
+bool operator!=(const BinarySearchTree<T, Compare, Alloc, Balance, Augment, Threading>& first, 
+                const BinarySearchTree<T, Compare, Alloc, Balance, Augment, Threading>& second) { 
     return !(first == second); 
 }
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "BST.cpp"
+
+// Orders the std::pair<const K, V> elements of the map containers by key alone, so that a
+// lookup takes the key itself and never builds a pair.
+template <typename K, typename V, typename Compare = std::less<K>>
+struct map_compare {
+    using is_transparent = void;
+    using value_type = std::pair<const K, V>;
+
+    [[no_unique_address]] Compare comp{};
+
+    bool operator()(const value_type& a, const value_type& b) const { return comp(a.first, b.first); }
+    bool operator()(const value_type& a, const K& b) const { return comp(a.first, b); }
+    bool operator()(const K& a, const value_type& b) const { return comp(a, b.first); }
+
+    template <typename U>
+    requires requires { typename Compare::is_transparent; }
+    bool operator()(const value_type& a, const U& b) const { return comp(a.first, b); }
+
+    template <typename U>
+    requires requires { typename Compare::is_transparent; }
+    bool operator()(const U& a, const value_type& b) const { return comp(a, b.first); }
+};
+
+// Whether lookups may take other types than the key without converting them first.
+template <typename Compare>
+inline constexpr bool transparent_lookup_v = requires { typename Compare::is_transparent; };
+
+template <typename K, typename V, typename Compare>
+inline constexpr bool transparent_lookup_v<map_compare<K, V, Compare>> = requires { typename Compare::is_transparent; };
+
+// Comparator of bare keys inside the element comparator: Compare itself for the set variants,
+// the wrapped key comparator of map_compare for the map variants.
+template <typename Compare>
+struct key_compare_of {
+    using type = Compare;
+
+    static type get(const Compare& comp) { return comp; }
+};
+
+template <typename K, typename V, typename Compare>
+struct key_compare_of<map_compare<K, V, Compare>> {
+    using type = Compare;
+
+    static type get(const map_compare<K, V, Compare>& comp) { return comp.comp; }
+};
+
+// Sorted container over BinarySearchTree<Value, ...> whose lookups take a Key: the set variants
+// use Value = Key, the map variants std::pair<const Key, V> ordered by map_compare. Multi keeps
+// every equivalent element, in insertion order; otherwise keys are unique as in the tree.
+template <typename Key, typename Value, typename Compare, typename Alloc, typename Balance, typename Augment, bool Multi>
+class KeyedTree: private BinarySearchTree<Value, Compare, Alloc, Balance, Augment> {
+protected:
+    using Base = BinarySearchTree<Value, Compare, Alloc, Balance, Augment>;
+    using node_type = typename Base::node_type;
+    using Position = typename Base::Position;
+
+    static constexpr bool is_transparent_ = transparent_lookup_v<Compare>;
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = typename Base::template iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using const_iterator = typename Base::template const_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using reverse_iterator = typename Base::template reverse_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using const_reverse_iterator = typename Base::template const_reverse_iterator<OrderType>;
+
+    using value_type = Value;
+    using reference = Value&;
+    using const_reference = const Value&;
+    using size_type = size_t;
+
+    using key_type = Key;
+    using key_compare = typename key_compare_of<Compare>::type;
+    using value_compare = Compare;
+    using allocator_type = Alloc;
+
+    using Base::begin;
+    using Base::end;
+    using Base::cbegin;
+    using Base::cend;
+    using Base::rbegin;
+    using Base::rend;
+    using Base::crbegin;
+    using Base::crend;
+    using Base::size;
+    using Base::max_size;
+    using Base::empty;
+    using Base::clear;
+    using Base::nth;
+    using Base::rank;
+    using Base::count_range;
+    using Base::aggregate;
+    using Base::find_from;
+    using Base::find_batch;
+    using Base::lower_bound_batch;
+    using Base::view;
+    using Base::range;
+    using Base::keys_from;
+    using Base::value_comp;
+    using Base::get_allocator;
+
+    KeyedTree() = default;
+
+    key_compare key_comp() const { return key_compare_of<Compare>::get(this->value_comp()); }
+
+    KeyedTree(const std::initializer_list<value_type>& il) { insert(il); }
+
+    template <typename It>
+    KeyedTree(It first, It last) { insert(first, last); }
+
+    // iterator for Multi containers, std::pair<iterator, bool> otherwise.
+    auto insert(const_reference value) { return emplace(value); }
+
+    auto insert(value_type&& value) { return emplace(std::move(value)); }
+
+    template <typename It>
+    void insert(It first, It last) {
+        for (; first != last; ++first) {
+            emplace(*first);
+        }
+    }
+
+    void insert(const std::initializer_list<value_type>& il) { insert(il.begin(), il.end()); }
+
+    template <typename... Args>
+    auto emplace(Args&&... args) {
+        if constexpr (Multi) {
+            node_type* val = this->create_node_(std::forward<Args>(args)...);
+            Position pos = slot_after_(val->data_);
+            this->attach_(pos.node, pos.to_left, val);
+            return iterator<>{val};
+        } else {
+            return Base::emplace(std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> erase(iterator<OrderType> pos) { return Base::erase(pos); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> erase(iterator<OrderType> first, iterator<OrderType> last) { return Base::erase(first, last); }
+
+    // Removes every element equivalent to key.
+    size_type erase(const key_type& key) { return erase_key_(key); }
+
+    template <typename K>
+    requires is_transparent_
+    size_type erase(const K& key) { return erase_key_(key); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> find(const key_type& key) const { return Base::template find<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find(const K& key) const { return Base::template find<OrderType>(key); }
+
+    bool contains(const key_type& key) const { return find(key) != end(); }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const { return find(key) != end(); }
+
+    size_type count(const key_type& key) const { return count_(key); }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return count_(key); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> lower_bound(const key_type& key) const { return Base::template lower_bound<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> lower_bound(const K& key) const { return Base::template lower_bound<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> upper_bound(const key_type& key) const { return Base::template upper_bound<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> upper_bound(const K& key) const { return Base::template upper_bound<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const key_type& key) const {
+        return Base::template equal_range<OrderType>(key);
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const K& key) const {
+        return Base::template equal_range<OrderType>(key);
+    }
+
+    friend bool operator==(const KeyedTree& first, const KeyedTree& second) {
+        if (first.size() != second.size()) {
+            return false;
+        }
+        for (auto it = first.begin(), other = second.begin(); it != first.end(); ++it, ++other) {
+            if (!(*it == *other)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    // Builds value_type(piecewise_construct, (key), (args...)) only if key is not present yet.
+    template <typename K, typename... Args>
+    std::pair<iterator<>, bool> try_emplace_(K&& key, Args&&... args) {
+        Position pos = this->locate_(key);
+        if (pos.found) {
+            return {iterator<>{pos.node}, false};
+        }
+        node_type* val = this->create_node_(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                            std::forward_as_tuple(std::forward<Args>(args)...));
+        this->attach_(pos.node, pos.to_left, val);
+        return {iterator<>{val}, true};
+    }
+
+private:
+    // Free slot after every element equivalent to value.
+    Position slot_after_(const_reference value) const {
+        node_type* now = this->fake_node_->left;
+        node_type* par = static_cast<node_type*>(this->fake_node_);
+        bool to_left = true;
+        while (now != nullptr) {
+            par = now;
+            to_left = this->comp_(value, now->data_);
+            now = to_left ? now->left : now->right;
+        }
+        return {par, to_left, false};
+    }
+
+    template <typename K>
+    size_type count_(const K& key) const {
+        if constexpr (!Multi) {
+            return contains(key) ? 1 : 0;
+        } else if constexpr (Base::counted_) {
+            return count_range(key, key);
+        } else {
+            auto range = equal_range(key);
+            size_type count = 0;
+            for (; range.first != range.second; ++range.first) {
+                ++count;
+            }
+            return count;
+        }
+    }
+
+    template <typename K>
+    size_type erase_key_(const K& key) {
+        auto range = equal_range(key);
+        size_type count = 0;
+        while (range.first != range.second) {
+            range.first = Base::erase(range.first);
+            ++count;
+        }
+        return count;
+    }
+};
+
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>, typename Balance = red_black_tag,
+          typename Augment = no_augment_tag>
+using BinarySearchMultiset = KeyedTree<T, T, Compare, Alloc, Balance, Augment, true>;
+
+// Map keeping every pair with an equivalent key, in insertion order.
+template <typename K, typename V, typename Compare = std::less<K>, typename Alloc = std::allocator<std::pair<const K, V>>,
+          typename Balance = red_black_tag, typename Augment = no_augment_tag>
+class BinarySearchMultimap: public KeyedTree<K, std::pair<const K, V>, map_compare<K, V, Compare>, Alloc, Balance, Augment, true> {
+private:
+    using Keyed = KeyedTree<K, std::pair<const K, V>, map_compare<K, V, Compare>, Alloc, Balance, Augment, true>;
+
+public:
+    using mapped_type = V;
+
+    using Keyed::Keyed;
+};
+
+// Unique-key map; the value lives inline in the tree node next to its key.
+template <typename K, typename V, typename Compare = std::less<K>, typename Alloc = std::allocator<std::pair<const K, V>>,
+          typename Balance = red_black_tag, typename Augment = no_augment_tag>
+class BinarySearchMap: public KeyedTree<K, std::pair<const K, V>, map_compare<K, V, Compare>, Alloc, Balance, Augment, false> {
+private:
+    using Keyed = KeyedTree<K, std::pair<const K, V>, map_compare<K, V, Compare>, Alloc, Balance, Augment, false>;
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = typename Keyed::template iterator<OrderType>;
+
+    using mapped_type = V;
+
+    using Keyed::Keyed;
+
+    // Constructs the value from args only if key is not present; args are left untouched otherwise.
+    template <typename... Args>
+    std::pair<iterator<>, bool> try_emplace(const K& key, Args&&... args) {
+        return this->try_emplace_(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator<>, bool> try_emplace(K&& key, Args&&... args) {
+        return this->try_emplace_(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename M>
+    std::pair<iterator<>, bool> insert_or_assign(const K& key, M&& obj) {
+        auto res = this->try_emplace_(key, std::forward<M>(obj));
+        if (!res.second) {
+            res.first->second = std::forward<M>(obj);
+        }
+        return res;
+    }
+
+    template <typename M>
+    std::pair<iterator<>, bool> insert_or_assign(K&& key, M&& obj) {
+        auto res = this->try_emplace_(std::move(key), std::forward<M>(obj));
+        if (!res.second) {
+            res.first->second = std::forward<M>(obj);
+        }
+        return res;
+    }
+
+    V& operator[](const K& key) { return this->try_emplace_(key).first->second; }
+
+    V& operator[](K&& key) { return this->try_emplace_(std::move(key)).first->second; }
+};
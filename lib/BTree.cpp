@@ -0,0 +1,925 @@
+#pragma once
+
+#include <type_traits>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include <new>
+
+#include "BST.cpp"
+#include "SimdSearch.cpp"
+
+// B-tree with the BinarySearchTree interface. Every node keeps up to NodeBytes worth of keys
+// in one contiguous block, so a lookup touches O(log_B n) nodes and inorder scans walk arrays.
+// Preorder visits the keys of a node before its children, postorder after them.
+// Unlike BinarySearchTree, insert and erase invalidate iterators.
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>, size_t NodeBytes = 256>
+class BTree {
+private:
+    static constexpr size_t kSlots = std::max<size_t>(3, NodeBytes / sizeof(T));
+    static constexpr size_t kMinSlots = (kSlots - 1) / 2;
+
+    static_assert(kSlots <= std::numeric_limits<unsigned short>::max());
+
+    struct InternalNode;
+
+    struct LeafNode {
+        InternalNode* parent;
+        unsigned short position;
+        unsigned short count;
+        bool leaf;
+        alignas(T) unsigned char storage_[kSlots * sizeof(T)];
+
+        T* key(size_t i) { return std::launder(reinterpret_cast<T*>(storage_)) + i; }
+        const T* key(size_t i) const { return std::launder(reinterpret_cast<const T*>(storage_)) + i; }
+    };
+
+    struct InternalNode: LeafNode {
+        LeafNode* children[kSlots + 1];
+    };
+
+    using LeafAlloc = std::allocator_traits<Alloc>::template rebind_alloc<LeafNode>;
+    using InternalAlloc = std::allocator_traits<Alloc>::template rebind_alloc<InternalNode>;
+
+    static constexpr bool is_transparent_ = requires { typename Compare::is_transparent; };
+
+    // Arithmetic keys under the default ordering are ranked inside a node with SIMD compares.
+    template <typename K>
+    static constexpr bool simd_search_ = simd_search::supported_v<T> && std::is_same_v<K, T>
+                                      && (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>>);
+
+    LeafNode* root_;
+    // Rightmost leaf, which holds the inorder and preorder end(); null when empty.
+    LeafNode* last_leaf_ = nullptr;
+    LeafAlloc leaf_alloc_;
+    InternalAlloc internal_alloc_;
+    Compare comp_;
+    size_t size_;
+
+    // Slot followed during erase so that the returned iterator survives rebalancing.
+    LeafNode* tracked_node_ = nullptr;
+    size_t tracked_pos_ = 0;
+
+    static InternalNode* internal_(LeafNode* node) { return static_cast<InternalNode*>(node); }
+
+    static LeafNode* child_(const LeafNode* node, size_t i) {
+        return static_cast<const InternalNode*>(node)->children[i];
+    }
+
+    static LeafNode* leftmost_(LeafNode* node) {
+        while (!node->leaf) {
+            node = child_(node, 0);
+        }
+        return node;
+    }
+
+    static LeafNode* rightmost_(LeafNode* node) {
+        while (!node->leaf) {
+            node = child_(node, node->count);
+        }
+        return node;
+    }
+
+    template <typename OrderType = inorder_tag>
+    class base_iterator {
+    friend BTree;
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        using pointer_type = pointer;
+        using referense_type = reference;
+        using key_type = const T;
+
+        base_iterator() = default;
+        base_iterator(const base_iterator&) = default;
+        base_iterator& operator=(const base_iterator&) = default;
+
+        bool operator==(const base_iterator&) const = default;
+        bool operator!=(const base_iterator&) const = default;
+
+        referense_type operator*() const { return *node_->key(pos_); }
+        pointer_type operator->() const { return node_->key(pos_); }
+
+        base_iterator& operator++() {
+            return increment(OrderType{});
+        }
+
+        base_iterator& operator--() {
+            return decrement(OrderType{});
+        }
+
+        base_iterator operator++(int) {
+            auto copy = *this;
+            ++(*this);
+            return copy;
+        }
+
+        base_iterator operator--(int) {
+            auto copy = *this;
+            --(*this);
+            return copy;
+        }
+
+        base_iterator& increment(inorder_tag) {
+            if (!node_->leaf) {
+                node_ = leftmost_(child_(node_, pos_ + 1));
+                pos_ = 0;
+                return *this;
+            }
+            if (++pos_ < node_->count) {
+                return *this;
+            }
+            LeafNode* last = node_;
+            while (pos_ == node_->count && node_->parent != nullptr) {
+                pos_ = node_->position;
+                node_ = node_->parent;
+            }
+            if (pos_ == node_->count) {
+                node_ = last;
+                pos_ = last->count;
+            }
+            return *this;
+        }
+
+        base_iterator& decrement(inorder_tag) {
+            if (!node_->leaf) {
+                node_ = rightmost_(child_(node_, pos_));
+                pos_ = node_->count - 1;
+                return *this;
+            }
+            if (pos_ > 0) {
+                --pos_;
+                return *this;
+            }
+            while (node_->position == 0) {
+                node_ = node_->parent;
+            }
+            pos_ = node_->position - 1;
+            node_ = node_->parent;
+            return *this;
+        }
+
+        base_iterator& increment(preorder_tag) {
+            if (++pos_ < node_->count) {
+                return *this;
+            }
+            if (!node_->leaf) {
+                node_ = child_(node_, 0);
+                pos_ = 0;
+                return *this;
+            }
+            LeafNode* now = node_;
+            while (now->parent != nullptr) {
+                if (now->position < now->parent->count) {
+                    node_ = child_(now->parent, now->position + 1);
+                    pos_ = 0;
+                    return *this;
+                }
+                now = now->parent;
+            }
+            return *this;
+        }
+
+        base_iterator& decrement(preorder_tag) {
+            if (pos_ > 0) {
+                --pos_;
+                return *this;
+            }
+            if (node_->position == 0) {
+                node_ = node_->parent;
+            } else {
+                node_ = rightmost_(child_(node_->parent, node_->position - 1));
+            }
+            pos_ = node_->count - 1;
+            return *this;
+        }
+
+        base_iterator& increment(postorder_tag) {
+            if (++pos_ < node_->count || node_->parent == nullptr) {
+                return *this;
+            }
+            if (node_->position < node_->parent->count) {
+                node_ = child_(node_->parent, node_->position + 1);
+                while (!node_->leaf) {
+                    node_ = child_(node_, 0);
+                }
+            } else {
+                node_ = node_->parent;
+            }
+            pos_ = 0;
+            return *this;
+        }
+
+        base_iterator& decrement(postorder_tag) {
+            if (pos_ > 0) {
+                --pos_;
+                return *this;
+            }
+            if (!node_->leaf) {
+                node_ = child_(node_, node_->count);
+            } else {
+                while (node_->position == 0) {
+                    node_ = node_->parent;
+                }
+                node_ = child_(node_->parent, node_->position - 1);
+            }
+            pos_ = node_->count - 1;
+            return *this;
+        }
+
+    private:
+        LeafNode* node_ = nullptr;
+        size_t pos_ = 0;
+
+        base_iterator(LeafNode* node, size_t pos) : node_(node), pos_(pos) {}
+    };
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using const_iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using reverse_iterator = std::reverse_iterator<iterator<OrderType>>;
+
+    template <typename OrderType = inorder_tag>
+    using const_reverse_iterator = std::reverse_iterator<const_iterator<OrderType>>;
+
+    using value_type = T;
+    using reference = T&;
+    using const_reference = const T&;
+
+    template <typename OrderType = inorder_tag>
+    using difference_type = std::iterator_traits<iterator<OrderType>>::difference_type;
+
+    using size_type = size_t;
+
+    using key_type = T;
+    using key_compare = Compare;
+    using value_compare = Compare;
+
+    using allocator_type = Alloc;
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> begin() const { return iterator<OrderType>(beg_(OrderType{}), 0); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> end() const { return end_(OrderType{}); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cbegin() const { return begin<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cend() const { return end<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rbegin() const { return reverse_iterator<OrderType>(end<OrderType>()); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rend() const { return reverse_iterator<OrderType>(begin<OrderType>()); }
+
+    template <typename OrderType = inorder_tag>
+    const_reverse_iterator<OrderType> crbegin() const { return reverse_iterator<OrderType>(end<OrderType>()); }
+
+    template <typename OrderType = inorder_tag>
+    const_reverse_iterator<OrderType> crend() const { return reverse_iterator<OrderType>(begin<OrderType>()); }
+
+    BTree() : root_(nullptr), leaf_alloc_(), internal_alloc_(), comp_(), size_(0) {}
+
+    BTree(const_reference element) : BTree() {
+        insert(element);
+    }
+
+    BTree(const std::initializer_list<value_type>& il) : BTree() {
+        insert(il);
+    }
+
+    BTree(const std::initializer_list<value_type>& il, key_compare comp) : BTree() {
+        comp_ = comp;
+        insert(il);
+    }
+
+    template <typename OrderType = inorder_tag>
+    BTree(base_iterator<OrderType>& first, base_iterator<OrderType>& second) : BTree() {
+        insert(first, second);
+    }
+
+    BTree(const BTree& other) : BTree() {
+        comp_ = other.comp_;
+        if (other.root_ != nullptr) {
+            root_ = clone_(other.root_, nullptr, 0);
+            last_leaf_ = rightmost_(root_);
+            size_ = other.size_;
+        }
+    }
+
+    BTree(BTree&& other) noexcept
+    : root_(other.root_), last_leaf_(other.last_leaf_), leaf_alloc_(std::move(other.leaf_alloc_)),
+      internal_alloc_(std::move(other.internal_alloc_)), comp_(std::move(other.comp_)), size_(other.size_) {
+        other.root_ = nullptr;
+        other.last_leaf_ = nullptr;
+        other.size_ = 0;
+    }
+
+    ~BTree() {
+        clear();
+    }
+
+    BTree& operator=(std::initializer_list<value_type> il) {
+        clear();
+        insert(il);
+        return *this;
+    }
+
+    BTree& operator=(const BTree& other) {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        comp_ = other.comp_;
+        if (other.root_ != nullptr) {
+            root_ = clone_(other.root_, nullptr, 0);
+            last_leaf_ = rightmost_(root_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    BTree& operator=(BTree&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        clear();
+        std::swap(root_, other.root_);
+        std::swap(last_leaf_, other.last_leaf_);
+        std::swap(size_, other.size_);
+        comp_ = std::move(other.comp_);
+        leaf_alloc_ = std::move(other.leaf_alloc_);
+        internal_alloc_ = std::move(other.internal_alloc_);
+        return *this;
+    }
+
+    size_type size() const { return size_; }
+
+    size_type max_size() const { return std::numeric_limits<size_type>::max(); }
+
+    bool empty() const { return size_ == 0; }
+
+    template <typename OrderType = inorder_tag>
+    void insert(OrderType first, OrderType second) {
+        while (first != second) {
+            insert(*first);
+            ++first;
+        }
+    }
+
+    void insert(const std::initializer_list<value_type>& il) {
+        insert(il.begin(), il.end());
+    }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, bool> insert(const_reference key) {
+        return emplace_at_<OrderType>(key, key);
+    }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, bool> insert(value_type&& key) {
+        return emplace_at_<OrderType>(key, std::move(key));
+    }
+
+    template <typename OrderType = inorder_tag, typename... Args>
+    std::pair<iterator<OrderType>, bool> emplace(Args&&... args) {
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return emplace_at_<OrderType>(args..., std::forward<Args>(args)...);
+        } else {
+            value_type val(std::forward<Args>(args)...);
+            return emplace_at_<OrderType>(val, std::move(val));
+        }
+    }
+
+    // Inserts right before hint without a descent when the key belongs there; any other hint
+    // costs an ordinary emplace.
+    template <typename... Args>
+    iterator<> emplace_hint(iterator<> hint, Args&&... args) {
+        if constexpr (sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, value_type> && ...)) {
+            return emplace_near_(hint, args..., std::forward<Args>(args)...);
+        } else {
+            value_type val(std::forward<Args>(args)...);
+            return emplace_near_(hint, val, std::move(val));
+        }
+    }
+
+    template <typename OrderType = inorder_tag, typename K, typename... Args>
+    std::pair<iterator<OrderType>, bool> try_emplace(K&& key, Args&&... args) {
+        return emplace_at_<OrderType>(key, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> erase(iterator<OrderType> val) {
+        iterator<OrderType> next = val;
+        ++next;
+        bool last = (next == end<OrderType>());
+        tracked_node_ = next.node_;
+        tracked_pos_ = next.pos_;
+        remove_(val.node_, val.pos_);
+        LeafNode* node = tracked_node_;
+        size_t pos = tracked_pos_;
+        tracked_node_ = nullptr;
+        if (last) {
+            return end<OrderType>();
+        }
+        return iterator<OrderType>(node, pos);
+    }
+
+    size_type erase(const_reference key) {
+        auto it = find(key);
+        if (it != end()) {
+            erase(it);
+            return 1;
+        }
+        return 0;
+    }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> erase(iterator<OrderType> st, iterator<OrderType> fn) {
+        if (st == begin<OrderType>() && fn == end<OrderType>()) {
+            clear();
+            return end<OrderType>();
+        }
+        size_type count = 0;
+        for (auto it = st; it != fn; ++it) {
+            ++count;
+        }
+        while (count-- > 0) {
+            st = erase<OrderType>(st);
+        }
+        return st;
+    }
+
+    void clear() {
+        if (root_ != nullptr) {
+            destroy_(root_);
+            root_ = nullptr;
+            last_leaf_ = nullptr;
+        }
+        size_ = 0;
+    }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> find(const_reference key) const { return find_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find(const K& key) const { return find_<OrderType>(key); }
+
+    bool contains(const_reference key) const { return find(key) != end(); }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const { return find(key) != end(); }
+
+    size_type count(const_reference key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> lower_bound(const_reference key) const { return lower_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> lower_bound(const K& key) const { return lower_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> upper_bound(const_reference key) const { return upper_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> upper_bound(const K& key) const { return upper_bound_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const_reference key) const {
+        return std::make_pair(lower_bound_<OrderType>(key), upper_bound_<OrderType>(key));
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const K& key) const {
+        return std::make_pair(lower_bound_<OrderType>(key), upper_bound_<OrderType>(key));
+    }
+
+    key_compare key_comp() const { return comp_; }
+
+    value_compare value_comp() const { return comp_; }
+
+    allocator_type get_allocator() const { return leaf_alloc_; }
+
+private:
+    LeafNode* beg_(inorder_tag) const { return (root_ != nullptr) ? leftmost_(root_) : nullptr; }
+
+    LeafNode* beg_(preorder_tag) const { return root_; }
+
+    LeafNode* beg_(postorder_tag) const { return beg_(inorder_tag{}); }
+
+    iterator<inorder_tag> end_(inorder_tag) const {
+        return iterator<inorder_tag>(last_leaf_, (last_leaf_ != nullptr) ? last_leaf_->count : 0);
+    }
+
+    iterator<preorder_tag> end_(preorder_tag) const {
+        return iterator<preorder_tag>(last_leaf_, (last_leaf_ != nullptr) ? last_leaf_->count : 0);
+    }
+
+    iterator<postorder_tag> end_(postorder_tag) const {
+        return iterator<postorder_tag>(root_, (root_ != nullptr) ? root_->count : 0);
+    }
+
+    // Index of the first key in node that is not less than key.
+    template <typename K>
+    size_t lower_index_(const LeafNode* node, const K& key) const {
+        if constexpr (simd_search_<K>) {
+            return simd_search::count<false>(node->key(0), node->count, key);
+        }
+        size_t lo = 0;
+        size_t hi = node->count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (comp_(*node->key(mid), key)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    template <typename K>
+    size_t upper_index_(const LeafNode* node, const K& key) const {
+        if constexpr (simd_search_<K>) {
+            return simd_search::count<true>(node->key(0), node->count, key);
+        }
+        size_t lo = 0;
+        size_t hi = node->count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (comp_(key, *node->key(mid))) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> lower_bound_(const K& key) const {
+        LeafNode* now = root_;
+        LeafNode* best = nullptr;
+        size_t best_pos = 0;
+        while (now != nullptr) {
+            size_t i = lower_index_(now, key);
+            if (i < now->count) {
+                best = now;
+                best_pos = i;
+            }
+            now = now->leaf ? nullptr : child_(now, i);
+        }
+        return (best != nullptr) ? iterator<OrderType>(best, best_pos) : end<OrderType>();
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> upper_bound_(const K& key) const {
+        LeafNode* now = root_;
+        LeafNode* best = nullptr;
+        size_t best_pos = 0;
+        while (now != nullptr) {
+            size_t i = upper_index_(now, key);
+            if (i < now->count) {
+                best = now;
+                best_pos = i;
+            }
+            now = now->leaf ? nullptr : child_(now, i);
+        }
+        return (best != nullptr) ? iterator<OrderType>(best, best_pos) : end<OrderType>();
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> find_(const K& key) const {
+        auto it = lower_bound_<OrderType>(key);
+        if (it != end<OrderType>() && !comp_(key, *it)) {
+            return it;
+        }
+        return end<OrderType>();
+    }
+
+    template <typename K>
+    decltype(auto) probe_(const K& key) const {
+        if constexpr (is_transparent_ || std::is_same_v<K, key_type>) {
+            return (key);
+        } else {
+            return key_type(key);
+        }
+    }
+
+    template <typename OrderType, typename K, typename... Args>
+    std::pair<iterator<OrderType>, bool> emplace_at_(const K& key, Args&&... args) {
+        decltype(auto) probe = probe_(key);
+        if (root_ == nullptr) {
+            root_ = create_node_(true);
+            last_leaf_ = root_;
+        }
+        LeafNode* now = root_;
+        size_t i;
+        while (true) {
+            i = lower_index_(now, probe);
+            if (i < now->count && !comp_(probe, *now->key(i))) {
+                return std::pair(iterator<OrderType>(now, i), false);
+            }
+            if (now->leaf) {
+                break;
+            }
+            now = child_(now, i);
+        }
+        return std::pair(insert_at_<OrderType>(now, i, std::forward<Args>(args)...), true);
+    }
+
+    // Position of key is right before hint when the neighbours on both sides agree.
+    template <typename... Args>
+    iterator<> emplace_near_(iterator<> hint, const value_type& key, Args&&... args) {
+        if (root_ != nullptr && (hint == end() || comp_(key, *hint)) && (is_first_(hint) || comp_(*std::prev(hint), key))) {
+            LeafNode* now = hint.node_;
+            size_t i = hint.pos_;
+            if (!now->leaf) {
+                now = rightmost_(child_(now, i));
+                i = now->count;
+            }
+            return insert_at_<inorder_tag>(now, i, std::forward<Args>(args)...);
+        }
+        return emplace_at_<inorder_tag>(key, std::forward<Args>(args)...).first;
+    }
+
+    // Whether no element comes before it in order; only climbs from the first slot of a leaf.
+    static bool is_first_(iterator<> it) {
+        if (!it.node_->leaf || it.pos_ > 0) {
+            return false;
+        }
+        const LeafNode* now = it.node_;
+        while (now->parent != nullptr && now->position == 0) {
+            now = now->parent;
+        }
+        return now->parent == nullptr;
+    }
+
+    // Builds the element in slot i of the leaf now, splitting the leaf first when it is full.
+    template <typename OrderType, typename... Args>
+    iterator<OrderType> insert_at_(LeafNode* now, size_t i, Args&&... args) {
+        if (now->count == kSlots) {
+            split_(now);
+            InternalNode* par = now->parent;
+            size_t sep = now->position;
+            if (i > now->count) {
+                i -= now->count + 1;
+                now = par->children[sep + 1];
+            }
+        }
+        open_gap_(now, i);
+        std::construct_at(now->key(i), std::forward<Args>(args)...);
+        ++now->count;
+        ++size_;
+        return iterator<OrderType>(now, i);
+    }
+
+    LeafNode* create_node_(bool leaf) {
+        LeafNode* node;
+        if (leaf) {
+            node = std::allocator_traits<LeafAlloc>::allocate(leaf_alloc_, 1);
+        } else {
+            node = std::allocator_traits<InternalAlloc>::allocate(internal_alloc_, 1);
+        }
+        node->parent = nullptr;
+        node->position = 0;
+        node->count = 0;
+        node->leaf = leaf;
+        return node;
+    }
+
+    void free_node_(LeafNode* node) {
+        if (node->leaf) {
+            std::allocator_traits<LeafAlloc>::deallocate(leaf_alloc_, node, 1);
+        } else {
+            std::allocator_traits<InternalAlloc>::deallocate(internal_alloc_, internal_(node), 1);
+        }
+    }
+
+    void destroy_(LeafNode* node) {
+        if (!node->leaf) {
+            for (size_t i = 0; i <= node->count; ++i) {
+                destroy_(child_(node, i));
+            }
+        }
+        std::destroy_n(node->key(0), node->count);
+        free_node_(node);
+    }
+
+    LeafNode* clone_(const LeafNode* src, InternalNode* par, size_t position) {
+        LeafNode* node = create_node_(src->leaf);
+        node->parent = par;
+        node->position = position;
+        for (size_t i = 0; i < src->count; ++i) {
+            std::construct_at(node->key(i), *src->key(i));
+            ++node->count;
+        }
+        if (!src->leaf) {
+            for (size_t i = 0; i <= src->count; ++i) {
+                internal_(node)->children[i] = clone_(child_(src, i), internal_(node), i);
+            }
+        }
+        return node;
+    }
+
+    void set_child_(InternalNode* par, size_t i, LeafNode* child) {
+        par->children[i] = child;
+        child->parent = par;
+        child->position = i;
+    }
+
+    // Moves an element between slots; dst must be raw storage, src is left as raw storage.
+    void move_key_(LeafNode* dst, size_t dst_pos, LeafNode* src, size_t src_pos) {
+        std::construct_at(dst->key(dst_pos), std::move(*src->key(src_pos)));
+        std::destroy_at(src->key(src_pos));
+        if (tracked_node_ == src && tracked_pos_ == src_pos) {
+            tracked_node_ = dst;
+            tracked_pos_ = dst_pos;
+        }
+    }
+
+    void open_gap_(LeafNode* node, size_t at) {
+        for (size_t i = node->count; i > at; --i) {
+            move_key_(node, i, node, i - 1);
+        }
+    }
+
+    void close_gap_(LeafNode* node, size_t at) {
+        for (size_t i = at; i + 1 < node->count; ++i) {
+            move_key_(node, i, node, i + 1);
+        }
+    }
+
+    void split_(LeafNode* node) {
+        if (node->parent == nullptr) {
+            InternalNode* top = internal_(create_node_(false));
+            set_child_(top, 0, node);
+            root_ = top;
+        } else if (node->parent->count == kSlots) {
+            split_(node->parent);
+        }
+        InternalNode* par = node->parent;
+        size_t pos = node->position;
+        size_t mid = kSlots / 2;
+        LeafNode* sibling = create_node_(node->leaf);
+        for (size_t i = mid + 1; i < kSlots; ++i) {
+            move_key_(sibling, i - mid - 1, node, i);
+        }
+        sibling->count = kSlots - mid - 1;
+        if (!node->leaf) {
+            for (size_t i = mid + 1; i <= kSlots; ++i) {
+                set_child_(internal_(sibling), i - mid - 1, child_(node, i));
+            }
+        }
+        open_gap_(par, pos);
+        for (size_t i = par->count + 1; i > pos + 1; --i) {
+            set_child_(par, i, par->children[i - 1]);
+        }
+        move_key_(par, pos, node, mid);
+        set_child_(par, pos + 1, sibling);
+        ++par->count;
+        node->count = mid;
+        if (node == last_leaf_) {
+            last_leaf_ = sibling;
+        }
+    }
+
+    void remove_(LeafNode* node, size_t pos) {
+        std::destroy_at(node->key(pos));
+        if (!node->leaf) {
+            LeafNode* prev = rightmost_(child_(node, pos));
+            move_key_(node, pos, prev, prev->count - 1);
+            node = prev;
+        } else {
+            for (size_t i = pos; i + 1 < node->count; ++i) {
+                move_key_(node, i, node, i + 1);
+            }
+        }
+        --node->count;
+        --size_;
+        rebalance_(node);
+    }
+
+    void rebalance_(LeafNode* node) {
+        while (node->parent != nullptr && node->count < kMinSlots) {
+            InternalNode* par = node->parent;
+            size_t pos = node->position;
+            LeafNode* left = (pos > 0) ? par->children[pos - 1] : nullptr;
+            LeafNode* right = (pos < par->count) ? par->children[pos + 1] : nullptr;
+            if (left != nullptr && left->count > kMinSlots) {
+                open_gap_(node, 0);
+                move_key_(node, 0, par, pos - 1);
+                move_key_(par, pos - 1, left, left->count - 1);
+                if (!node->leaf) {
+                    for (size_t i = node->count + 1; i > 0; --i) {
+                        set_child_(internal_(node), i, child_(node, i - 1));
+                    }
+                    set_child_(internal_(node), 0, child_(left, left->count));
+                }
+                --left->count;
+                ++node->count;
+                return;
+            }
+            if (right != nullptr && right->count > kMinSlots) {
+                move_key_(node, node->count, par, pos);
+                move_key_(par, pos, right, 0);
+                if (!node->leaf) {
+                    set_child_(internal_(node), node->count + 1, child_(right, 0));
+                    for (size_t i = 0; i < right->count; ++i) {
+                        set_child_(internal_(right), i, child_(right, i + 1));
+                    }
+                }
+                close_gap_(right, 0);
+                --right->count;
+                ++node->count;
+                return;
+            }
+            if (right != nullptr) {
+                merge_(node, right);
+            } else {
+                merge_(left, node);
+            }
+            node = par;
+        }
+        if (node->parent == nullptr && node->count == 0) {
+            if (node->leaf) {
+                root_ = nullptr;
+                last_leaf_ = nullptr;
+                tracked_node_ = nullptr;
+            } else {
+                root_ = child_(node, 0);
+                root_->parent = nullptr;
+                root_->position = 0;
+            }
+            free_node_(node);
+        }
+    }
+
+    // Appends the separator and every key of right to left, then drops right.
+    void merge_(LeafNode* left, LeafNode* right) {
+        InternalNode* par = left->parent;
+        size_t pos = left->position;
+        move_key_(left, left->count, par, pos);
+        for (size_t i = 0; i < right->count; ++i) {
+            move_key_(left, left->count + 1 + i, right, i);
+        }
+        if (!left->leaf) {
+            for (size_t i = 0; i <= right->count; ++i) {
+                set_child_(internal_(left), left->count + 1 + i, child_(right, i));
+            }
+        }
+        left->count += 1 + right->count;
+        close_gap_(par, pos);
+        for (size_t i = pos + 1; i < par->count; ++i) {
+            set_child_(par, i, par->children[i + 1]);
+        }
+        --par->count;
+        if (right == last_leaf_) {
+            last_leaf_ = left;
+        }
+        free_node_(right);
+    }
+};
+
+template <typename T, typename Compare, typename Alloc, size_t NodeBytes>
+bool operator==(const BTree<T, Compare, Alloc, NodeBytes>& first,
+                const BTree<T, Compare, Alloc, NodeBytes>& second) {
+    if (first.size() != second.size()) {
+        return false;
+    }
+    for (auto it1 = first.begin(), it2 = second.begin(); it1 != first.end(); ++it1, ++it2) {
+        if (*it1 != *it2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, typename Compare, typename Alloc, size_t NodeBytes>
+bool operator!=(const BTree<T, Compare, Alloc, NodeBytes>& first,
+                const BTree<T, Compare, Alloc, NodeBytes>& second) {
+    return !(first == second);
+}
@@ -0,0 +1,588 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "BST.cpp"
+#include "Epoch.cpp"
+
+// Search tree for many readers and writers. Readers take no locks: children are atomic
+// pointers and a lookup pins an Epoch instead. Writers lock only the nodes they change,
+// always ancestor before descendant. Erasing a key with two children only marks its node as
+// removed (it keeps routing searches); nodes with at most one child are spliced out and
+// retired to Epoch, so iterators and pointers obtained under a Guard stay valid.
+// Writers keep the tree AVL-balanced: a rotation never changes a node readers can reach, it
+// publishes fresh copies of the rotated nodes and retires the originals, which keep routing
+// the readers already inside them. T must therefore be copy constructible. Balancing is
+// relaxed: a writer stops fixing heights where another writer changed its path, so under
+// contention the tree is only close to AVL, and exact again once writes are serialized.
+// Iterators are inorder, weakly consistent and must not leave the thread that made them.
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class ConcurrentTree {
+private:
+    struct Node;
+
+    struct Link {
+        std::atomic<Node*> child[2]{};
+        std::atomic<bool> unlinked{false};
+        std::mutex mutex;
+    };
+
+    struct Node: Link {
+        T data_;
+        std::atomic<bool> removed{false};
+        // Height of the subtree, a leaf has 1; changed under the node lock, read without it.
+        std::atomic<int> height_{1};
+        template <typename... Args>
+        Node(Args&&... args) : data_(std::forward<Args>(args)...) {}
+    };
+
+    using NodeAlloc = std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using AllocTraits = std::allocator_traits<NodeAlloc>;
+
+    static_assert(AllocTraits::is_always_equal::value,
+                  "retired nodes are freed from other threads with a default-constructed allocator");
+
+    static constexpr bool is_transparent_ = requires { typename Compare::is_transparent; };
+
+    // holder_.child[0] is the root; holder_ is never unlinked.
+    Link holder_;
+    Compare comp_;
+    NodeAlloc alloc_;
+    std::atomic<size_t> size_{0};
+
+    class base_iterator {
+    friend ConcurrentTree;
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        using pointer_type = pointer;
+        using referense_type = reference;
+        using key_type = const T;
+
+        base_iterator() = default;
+        base_iterator(const base_iterator&) = default;
+        base_iterator& operator=(const base_iterator&) = default;
+
+        bool operator==(const base_iterator& other) const { return ptr_ == other.ptr_; }
+        bool operator!=(const base_iterator& other) const { return ptr_ != other.ptr_; }
+
+        referense_type operator*() const { return ptr_->data_; }
+        pointer_type operator->() const { return &ptr_->data_; }
+
+        base_iterator& operator++() {
+            ptr_ = tree_->template bound_<false>(ptr_->data_);
+            return *this;
+        }
+
+        base_iterator& operator--() {
+            ptr_ = (ptr_ != nullptr) ? tree_->before_(&ptr_->data_) : tree_->before_(static_cast<const T*>(nullptr));
+            return *this;
+        }
+
+        base_iterator operator++(int) {
+            auto copy = *this;
+            ++(*this);
+            return copy;
+        }
+
+        base_iterator operator--(int) {
+            auto copy = *this;
+            --(*this);
+            return copy;
+        }
+
+    private:
+        const ConcurrentTree* tree_ = nullptr;
+        Node* ptr_ = nullptr;
+        Epoch::Guard guard_;
+
+        base_iterator(const ConcurrentTree* tree, Node* ptr) : tree_(tree), ptr_(ptr) {}
+    };
+
+public:
+    using iterator = base_iterator;
+    using const_iterator = base_iterator;
+
+    using value_type = T;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = size_t;
+
+    using key_type = T;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Alloc;
+
+    ConcurrentTree() = default;
+
+    explicit ConcurrentTree(const Compare& comp) : comp_(comp) {}
+
+    ConcurrentTree(const std::initializer_list<value_type>& il) {
+        for (const_reference value : il) {
+            insert(value);
+        }
+    }
+
+    ConcurrentTree(const ConcurrentTree&) = delete;
+    ConcurrentTree& operator=(const ConcurrentTree&) = delete;
+
+    // No other thread may use the tree any more; retired nodes are left to Epoch.
+    ~ConcurrentTree() {
+        Node* now = holder_.child[0].load(std::memory_order_relaxed);
+        while (now != nullptr) {
+            Node* left = now->child[0].load(std::memory_order_relaxed);
+            if (left != nullptr) {
+                now->child[0].store(left->child[1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                left->child[1].store(now, std::memory_order_relaxed);
+                now = left;
+                continue;
+            }
+            Node* right = now->child[1].load(std::memory_order_relaxed);
+            drop_node_(now);
+            now = right;
+        }
+    }
+
+    const_iterator begin() const {
+        Epoch::Guard guard;
+        return iterator(this, first_());
+    }
+
+    const_iterator end() const { return iterator(this, nullptr); }
+
+    const_iterator cbegin() const { return begin(); }
+
+    const_iterator cend() const { return end(); }
+
+    // Exact when no writer is running.
+    size_type size() const { return size_.load(std::memory_order_relaxed); }
+
+    // Edges on the longest root-to-leaf path, removed nodes included. Exact when no writer is running.
+    size_type height() const {
+        Epoch::Guard guard;
+        size_type height = 0;
+        std::vector<std::pair<const Node*, size_type>> stack;
+        if (const Node* root = holder_.child[0].load(std::memory_order_acquire); root != nullptr) {
+            stack.emplace_back(root, 0);
+        }
+        while (!stack.empty()) {
+            auto [elem, depth] = stack.back();
+            stack.pop_back();
+            height = std::max(height, depth);
+            for (const auto& child : elem->child) {
+                if (const Node* next = child.load(std::memory_order_acquire); next != nullptr) {
+                    stack.emplace_back(next, depth + 1);
+                }
+            }
+        }
+        return height;
+    }
+
+    bool empty() const { return begin() == end(); }
+
+    std::pair<iterator, bool> insert(const_reference value) { return emplace_(value); }
+
+    std::pair<iterator, bool> insert(value_type&& value) { return emplace_(std::move(value)); }
+
+    void insert(const std::initializer_list<value_type>& il) {
+        for (const_reference value : il) {
+            insert(value);
+        }
+    }
+
+    size_type erase(const_reference key) { return erase_(key); }
+
+    template <typename K>
+    requires is_transparent_
+    size_type erase(const K& key) { return erase_(key); }
+
+    iterator find(const_reference key) const { return find_(key); }
+
+    template <typename K>
+    requires is_transparent_
+    iterator find(const K& key) const { return find_(key); }
+
+    bool contains(const_reference key) const {
+        Epoch::Guard guard;
+        return find_node_(key) != nullptr;
+    }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const {
+        Epoch::Guard guard;
+        return find_node_(key) != nullptr;
+    }
+
+    size_type count(const_reference key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return (contains(key)) ? 1 : 0; }
+
+    iterator lower_bound(const_reference key) const {
+        Epoch::Guard guard;
+        return iterator(this, bound_<true>(key));
+    }
+
+    template <typename K>
+    requires is_transparent_
+    iterator lower_bound(const K& key) const {
+        Epoch::Guard guard;
+        return iterator(this, bound_<true>(key));
+    }
+
+    iterator upper_bound(const_reference key) const {
+        Epoch::Guard guard;
+        return iterator(this, bound_<false>(key));
+    }
+
+    template <typename K>
+    requires is_transparent_
+    iterator upper_bound(const K& key) const {
+        Epoch::Guard guard;
+        return iterator(this, bound_<false>(key));
+    }
+
+    key_compare key_comp() const { return comp_; }
+
+    value_compare value_comp() const { return comp_; }
+
+    allocator_type get_allocator() const { return alloc_; }
+
+private:
+    template <typename K>
+    int compare_(const K& key, const T& value) const {
+        return comp_(key, value) ? -1 : (comp_(value, key) ? 1 : 0);
+    }
+
+    template <typename K>
+    Node* find_node_(const K& key) const {
+        Node* now = holder_.child[0].load(std::memory_order_acquire);
+        while (now != nullptr) {
+            int order = compare_(key, now->data_);
+            if (order == 0) {
+                return now->removed.load(std::memory_order_acquire) ? nullptr : now;
+            }
+            now = now->child[order > 0].load(std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    template <typename K>
+    iterator find_(const K& key) const {
+        Epoch::Guard guard;
+        return iterator(this, find_node_(key));
+    }
+
+    // Smallest live node not less than key (Inclusive) or greater than key. A removed node
+    // on the way is skipped by searching again past its key.
+    template <bool Inclusive, typename K>
+    Node* bound_(const K& key) const {
+        Node* best = nullptr;
+        Node* now = holder_.child[0].load(std::memory_order_acquire);
+        while (now != nullptr) {
+            bool go_left = Inclusive ? !comp_(now->data_, key) : comp_(key, now->data_);
+            best = go_left ? now : best;
+            now = now->child[go_left ? 0 : 1].load(std::memory_order_acquire);
+        }
+        if (best != nullptr && best->removed.load(std::memory_order_acquire)) {
+            return bound_<false>(best->data_);
+        }
+        return best;
+    }
+
+    Node* first_() const {
+        Node* now = holder_.child[0].load(std::memory_order_acquire);
+        if (now == nullptr) {
+            return nullptr;
+        }
+        for (Node* left = now; left != nullptr; left = left->child[0].load(std::memory_order_acquire)) {
+            now = left;
+        }
+        return now->removed.load(std::memory_order_acquire) ? bound_<false>(now->data_) : now;
+    }
+
+    // Largest live node less than *key, or the largest live node when key is null.
+    Node* before_(const T* key) const {
+        Node* best = nullptr;
+        Node* now = holder_.child[0].load(std::memory_order_acquire);
+        while (now != nullptr) {
+            bool go_right = (key == nullptr) || comp_(now->data_, *key);
+            best = go_right ? now : best;
+            now = now->child[go_right ? 1 : 0].load(std::memory_order_acquire);
+        }
+        if (best != nullptr && best->removed.load(std::memory_order_acquire)) {
+            return before_(&best->data_);
+        }
+        return best;
+    }
+
+    template <typename... Args>
+    Node* create_node_(Args&&... args) {
+        Node* val = alloc_.allocate(1);
+        AllocTraits::construct(alloc_, val, std::forward<Args>(args)...);
+        return val;
+    }
+
+    void drop_node_(Node* elem) {
+        AllocTraits::destroy(alloc_, elem);
+        alloc_.deallocate(elem, 1);
+    }
+
+    static void retire_(Node* elem) {
+        Epoch::retire(elem, [](void* ptr) {
+            NodeAlloc alloc;
+            Node* node = static_cast<Node*>(ptr);
+            AllocTraits::destroy(alloc, node);
+            alloc.deallocate(node, 1);
+        });
+    }
+
+    // Nodes of the last search path: now sits in par->child[dir], par in grand->child[par_dir].
+    struct Path {
+        Link* grand;
+        int par_dir;
+        Link* par;
+        int dir;
+        Node* now;
+    };
+
+    template <typename K>
+    Path search_(const K& key) {
+        Path path{nullptr, 0, &holder_, 0, holder_.child[0].load(std::memory_order_acquire)};
+        while (path.now != nullptr) {
+            int order = compare_(key, path.now->data_);
+            if (order == 0) {
+                break;
+            }
+            path.grand = path.par;
+            path.par_dir = path.dir;
+            path.par = path.now;
+            path.dir = order > 0;
+            path.now = path.now->child[path.dir].load(std::memory_order_acquire);
+        }
+        return path;
+    }
+
+    template <typename Arg>
+    std::pair<iterator, bool> emplace_(Arg&& value) {
+        Epoch::Guard guard;
+        Node* val = nullptr;
+        while (true) {
+            // Once val is built, value may have been moved into it.
+            Path path = (val != nullptr) ? search_(val->data_) : search_(value);
+            if (path.now != nullptr) {
+                Node* now = path.now;
+                if (!now->removed.load(std::memory_order_acquire)) {
+                    if (val != nullptr) {
+                        drop_node_(val);
+                    }
+                    return {iterator(this, now), false};
+                }
+                std::lock_guard<std::mutex> lock(now->mutex);
+                if (now->unlinked.load(std::memory_order_relaxed) || !now->removed.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                now->removed.store(false, std::memory_order_release);
+                size_.fetch_add(1, std::memory_order_relaxed);
+                if (val != nullptr) {
+                    drop_node_(val);
+                }
+                return {iterator(this, now), true};
+            }
+            if (val == nullptr) {
+                val = create_node_(std::forward<Arg>(value));
+            }
+            {
+                std::lock_guard<std::mutex> lock(path.par->mutex);
+                if (path.par->unlinked.load(std::memory_order_relaxed)
+                    || path.par->child[path.dir].load(std::memory_order_relaxed) != nullptr) {
+                    continue;
+                }
+                path.par->child[path.dir].store(val, std::memory_order_release);
+                size_.fetch_add(1, std::memory_order_relaxed);
+            }
+            rebalance_(path.par);
+            return {iterator(this, val), true};
+        }
+    }
+
+    template <typename K>
+    size_type erase_(const K& key) {
+        Epoch::Guard guard;
+        while (true) {
+            Path path = search_(key);
+            Node* now = path.now;
+            if (now == nullptr || now->removed.load(std::memory_order_acquire)) {
+                return 0;
+            }
+            std::unique_lock<std::mutex> par_lock(path.par->mutex);
+            std::unique_lock<std::mutex> lock(now->mutex);
+            if (path.par->unlinked.load(std::memory_order_relaxed)
+                || path.par->child[path.dir].load(std::memory_order_relaxed) != now
+                || now->unlinked.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            if (now->removed.load(std::memory_order_relaxed)) {
+                return 0;
+            }
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            if (!splice_(path.par, path.dir, now)) {
+                now->removed.store(true, std::memory_order_release);
+                return 1;
+            }
+            lock.unlock();
+            par_lock.unlock();
+            if (path.grand != nullptr && prune_(path.grand, path.par_dir, static_cast<Node*>(path.par))) {
+                rebalance_(path.grand);
+            } else {
+                rebalance_(path.par);
+            }
+            return 1;
+        }
+    }
+
+    // With par and elem locked, replaces elem by its only child; fails when it has two.
+    bool splice_(Link* par, int dir, Node* elem) {
+        Node* left = elem->child[0].load(std::memory_order_relaxed);
+        Node* right = elem->child[1].load(std::memory_order_relaxed);
+        if (left != nullptr && right != nullptr) {
+            return false;
+        }
+        elem->removed.store(true, std::memory_order_release);
+        elem->unlinked.store(true, std::memory_order_release);
+        par->child[dir].store((left != nullptr) ? left : right, std::memory_order_release);
+        retire_(elem);
+        return true;
+    }
+
+    // A removed node left with at most one child no longer routes anything; splice it out.
+    bool prune_(Link* par, int dir, Node* elem) {
+        if (!elem->removed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> par_lock(par->mutex);
+        std::lock_guard<std::mutex> lock(elem->mutex);
+        if (par->unlinked.load(std::memory_order_relaxed) || elem->unlinked.load(std::memory_order_relaxed)
+            || par->child[dir].load(std::memory_order_relaxed) != elem
+            || !elem->removed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        return splice_(par, dir, elem);
+    }
+
+    static int height_of_(const Node* elem) {
+        return (elem != nullptr) ? elem->height_.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Unpublished copy of the locked node elem with child[side] = inner and the other child outer.
+    Node* copy_node_(Node* elem, int side, Node* inner, Node* outer) {
+        Node* copy = create_node_(elem->data_);
+        copy->child[side].store(inner, std::memory_order_relaxed);
+        copy->child[1 - side].store(outer, std::memory_order_relaxed);
+        copy->removed.store(elem->removed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        copy->height_.store(1 + std::max(height_of_(inner), height_of_(outer)), std::memory_order_relaxed);
+        return copy;
+    }
+
+    // The locked node elem was replaced by a copy: writers that still reach it retry, readers
+    // finish their descent through it.
+    static void replace_(Node* elem) {
+        elem->unlinked.store(true, std::memory_order_release);
+        retire_(elem);
+    }
+
+    struct Step {
+        Link* par;
+        int dir;
+        Node* now;
+    };
+
+    // Fixes heights and balance from the node at from up to the root along its search path.
+    // Stops where a height no longer changes or where the path has been changed meanwhile.
+    void rebalance_(Link* from) {
+        if (from == &holder_) {
+            return;
+        }
+        Node* target = static_cast<Node*>(from);
+        thread_local std::vector<Step> trail;
+        trail.clear();
+        Step step{&holder_, 0, holder_.child[0].load(std::memory_order_acquire)};
+        while (step.now != target) {
+            if (step.now == nullptr) {
+                return;
+            }
+            int order = compare_(target->data_, step.now->data_);
+            if (order == 0) {
+                return;
+            }
+            trail.push_back(step);
+            step = {step.now, order > 0, step.now->child[order > 0].load(std::memory_order_acquire)};
+        }
+        trail.push_back(step);
+        for (size_t i = trail.size(); i-- > 0;) {
+            if (!fix_(trail[i])) {
+                return;
+            }
+        }
+    }
+
+    // With nothing locked, updates the height of step.now or rotates it; false when the
+    // walk up can stop.
+    bool fix_(const Step& step) {
+        std::lock_guard<std::mutex> par_lock(step.par->mutex);
+        std::lock_guard<std::mutex> lock(step.now->mutex);
+        if (step.par->unlinked.load(std::memory_order_relaxed) || step.now->unlinked.load(std::memory_order_relaxed)
+            || step.par->child[step.dir].load(std::memory_order_relaxed) != step.now) {
+            return false;
+        }
+        int diff = height_of_(step.now->child[0].load(std::memory_order_relaxed))
+                   - height_of_(step.now->child[1].load(std::memory_order_relaxed));
+        if (diff > 1 || diff < -1) {
+            rotate_(step, (diff > 1) ? 0 : 1);
+            return true;
+        }
+        int height = 1 + std::max(height_of_(step.now->child[0].load(std::memory_order_relaxed)),
+                                  height_of_(step.now->child[1].load(std::memory_order_relaxed)));
+        if (height == step.now->height_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        step.now->height_.store(height, std::memory_order_relaxed);
+        return true;
+    }
+
+    // With step.par and step.now locked, lifts the child on side of step.now (single rotation)
+    // or that child's inner child (double rotation) into its place.
+    void rotate_(const Step& step, int side) {
+        Node* elem = step.now;
+        Node* sub = elem->child[side].load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> sub_lock(sub->mutex);
+        Node* outer = sub->child[side].load(std::memory_order_relaxed);
+        Node* inner = sub->child[1 - side].load(std::memory_order_relaxed);
+        Node* other = elem->child[1 - side].load(std::memory_order_relaxed);
+        if (height_of_(inner) <= height_of_(outer)) {
+            Node* down = copy_node_(elem, side, inner, other);
+            step.par->child[step.dir].store(copy_node_(sub, side, outer, down), std::memory_order_release);
+            replace_(elem);
+            replace_(sub);
+            return;
+        }
+        std::lock_guard<std::mutex> inner_lock(inner->mutex);
+        Node* left = copy_node_(sub, side, outer, inner->child[side].load(std::memory_order_relaxed));
+        Node* right = copy_node_(elem, side, inner->child[1 - side].load(std::memory_order_relaxed), other);
+        step.par->child[step.dir].store(copy_node_(inner, side, left, right), std::memory_order_release);
+        replace_(elem);
+        replace_(sub);
+        replace_(inner);
+    }
+};
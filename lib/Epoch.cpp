@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation shared by the concurrent containers of the process. A thread pins
+// the current epoch with a Guard while it reads shared nodes; unlinked nodes are retired and
+// only freed once every thread that could still see them has left its Guard.
+class Epoch {
+private:
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    struct Record {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> active{false};
+        std::atomic<bool> owned{true};
+        unsigned depth = 0;
+        std::vector<Retired> retired;
+        Record* next = nullptr;
+    };
+
+    // Leases a Record to the thread and hands its leftovers to the orphan list on exit.
+    struct Holder {
+        Record* record;
+
+        Holder() : record(acquire_()) {}
+
+        ~Holder() {
+            {
+                std::lock_guard<std::mutex> lock(orphans_mutex_);
+                orphans_.insert(orphans_.end(), record->retired.begin(), record->retired.end());
+            }
+            record->retired.clear();
+            record->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    // Retired nodes are freed in batches of this size.
+    static constexpr size_t kCollectBatch = 64;
+
+    static inline std::atomic<uint64_t> global_{2};
+    static inline std::atomic<Record*> records_{nullptr};
+    static inline std::mutex orphans_mutex_;
+    static inline std::vector<Retired> orphans_;
+
+    static Record* acquire_() {
+        for (Record* now = records_.load(std::memory_order_acquire); now != nullptr; now = now->next) {
+            bool expected = false;
+            if (now->owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return now;
+            }
+        }
+        Record* record = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_acq_rel)) {
+        }
+        return record;
+    }
+
+    static Record& local_() {
+        thread_local Holder holder;
+        return *holder.record;
+    }
+
+    // The epoch moves on only when every pinned thread has seen the current one.
+    static uint64_t try_advance_() {
+        uint64_t now = global_.load();
+        for (Record* record = records_.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            if (record->active.load() && record->epoch.load() != now) {
+                return now;
+            }
+        }
+        global_.compare_exchange_strong(now, now + 1);
+        return global_.load();
+    }
+
+    static void free_expired_(std::vector<Retired>& retired, uint64_t now) {
+        size_t kept = 0;
+        for (Retired& item : retired) {
+            if (item.epoch + 2 <= now) {
+                item.deleter(item.ptr);
+            } else {
+                retired[kept++] = item;
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    class Guard {
+    public:
+        Guard() { pin_(); }
+        Guard(const Guard&) { pin_(); }
+        Guard& operator=(const Guard&) { return *this; }
+        ~Guard() { unpin_(); }
+
+    private:
+        static void pin_() {
+            Record& record = local_();
+            if (record.depth++ == 0) {
+                record.active.store(true);
+                record.epoch.store(global_.load());
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        static void unpin_() {
+            Record& record = local_();
+            if (--record.depth == 0) {
+                record.active.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    // ptr must already be unreachable for threads that pin from now on.
+    static void retire(void* ptr, void (*deleter)(void*)) {
+        Record& record = local_();
+        record.retired.push_back({ptr, deleter, global_.load()});
+        if (record.retired.size() >= kCollectBatch) {
+            collect();
+        }
+    }
+
+    // Frees what is safe to free on this thread and among the orphans; a few calls in a row
+    // from an unpinned thread release everything retired before them.
+    static void collect() {
+        uint64_t now = try_advance_();
+        free_expired_(local_().retired, now);
+        std::lock_guard<std::mutex> lock(orphans_mutex_);
+        free_expired_(orphans_, now);
+    }
+};
@@ -0,0 +1,381 @@
+#pragma once
+
+#include <bit>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "BST.cpp"
+
+// Immutable snapshot of a sorted set laid out in Eytzinger (breadth-first) order: the children
+// of slot k live in slots 2k and 2k + 1. A lookup is a branch-free descent that prefetches the
+// slots several levels ahead. Iterators walk this implicit complete tree, so inorder yields the
+// sorted keys and preorder/postorder follow the implicit shape.
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class FrozenTree {
+private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+
+    // Descendants four levels below slot k start at slot 16k; prefetch the line holding them.
+    static constexpr size_t kPrefetchStride = 16;
+
+    static constexpr bool is_transparent_ = requires { typename Compare::is_transparent; };
+
+    T* data_;
+    size_t size_;
+    Compare comp_;
+    Alloc alloc_;
+
+    template <typename OrderType = inorder_tag>
+    class base_iterator {
+    friend FrozenTree;
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        using pointer_type = pointer;
+        using referense_type = reference;
+        using key_type = const T;
+
+        base_iterator() = default;
+        base_iterator(const base_iterator&) = default;
+        base_iterator& operator=(const base_iterator&) = default;
+
+        bool operator==(const base_iterator& other) const { return slot_ == other.slot_ && data_ == other.data_; }
+        bool operator!=(const base_iterator& other) const { return !(*this == other); }
+
+        referense_type operator*() const { return data_[slot_]; }
+        pointer_type operator->() const { return data_ + slot_; }
+
+        base_iterator& operator++() {
+            return increment(OrderType{});
+        }
+
+        base_iterator& operator--() {
+            return decrement(OrderType{});
+        }
+
+        base_iterator operator++(int) {
+            auto copy = *this;
+            ++(*this);
+            return copy;
+        }
+
+        base_iterator operator--(int) {
+            auto copy = *this;
+            --(*this);
+            return copy;
+        }
+
+        base_iterator& increment(inorder_tag) {
+            if (2 * slot_ + 1 <= size_) {
+                slot_ = leftmost_(2 * slot_ + 1, size_);
+                return *this;
+            }
+            slot_ >>= std::countr_one(slot_) + 1;
+            return *this;
+        }
+
+        base_iterator& decrement(inorder_tag) {
+            if (slot_ == 0) {
+                slot_ = rightmost_(1, size_);
+            } else if (2 * slot_ <= size_) {
+                slot_ = rightmost_(2 * slot_, size_);
+            } else {
+                slot_ >>= std::countr_zero(slot_) + 1;
+            }
+            return *this;
+        }
+
+        base_iterator& increment(preorder_tag) {
+            if (2 * slot_ <= size_) {
+                slot_ *= 2;
+                return *this;
+            }
+            while (slot_ > 1) {
+                if (slot_ % 2 == 0 && slot_ + 1 <= size_) {
+                    ++slot_;
+                    return *this;
+                }
+                slot_ /= 2;
+            }
+            slot_ = 0;
+            return *this;
+        }
+
+        base_iterator& decrement(preorder_tag) {
+            if (slot_ == 0) {
+                slot_ = deepest_last_(1, size_);
+            } else if (slot_ % 2 == 1) {
+                slot_ = deepest_last_(slot_ - 1, size_);
+            } else {
+                slot_ /= 2;
+            }
+            return *this;
+        }
+
+        base_iterator& increment(postorder_tag) {
+            if (slot_ == 1) {
+                slot_ = 0;
+            } else if (slot_ % 2 == 0 && slot_ + 1 <= size_) {
+                slot_ = leftmost_(slot_ + 1, size_);
+            } else {
+                slot_ /= 2;
+            }
+            return *this;
+        }
+
+        base_iterator& decrement(postorder_tag) {
+            if (slot_ == 0) {
+                slot_ = 1;
+            } else if (2 * slot_ + 1 <= size_) {
+                slot_ = 2 * slot_ + 1;
+            } else if (2 * slot_ <= size_) {
+                slot_ = 2 * slot_;
+            } else {
+                while (slot_ % 2 == 0) {
+                    slot_ /= 2;
+                }
+                --slot_;
+            }
+            return *this;
+        }
+
+    private:
+        const T* data_ = nullptr;
+        size_t slot_ = 0;
+        size_t size_ = 0;
+
+        base_iterator(const T* data, size_t slot, size_t size) : data_(data), slot_(slot), size_(size) {}
+    };
+
+    static size_t leftmost_(size_t slot, size_t size) {
+        while (2 * slot <= size) {
+            slot *= 2;
+        }
+        return slot;
+    }
+
+    static size_t rightmost_(size_t slot, size_t size) {
+        while (2 * slot + 1 <= size) {
+            slot = 2 * slot + 1;
+        }
+        return slot;
+    }
+
+    // Last slot of the subtree in preorder: keep to the right child, or the left one if it is alone.
+    static size_t deepest_last_(size_t slot, size_t size) {
+        while (2 * slot <= size) {
+            slot = (2 * slot + 1 <= size) ? 2 * slot + 1 : 2 * slot;
+        }
+        return slot;
+    }
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using const_iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using reverse_iterator = std::reverse_iterator<iterator<OrderType>>;
+
+    template <typename OrderType = inorder_tag>
+    using const_reverse_iterator = std::reverse_iterator<const_iterator<OrderType>>;
+
+    using value_type = T;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = size_t;
+
+    using key_type = T;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Alloc;
+
+    FrozenTree() : data_(nullptr), size_(0), comp_(), alloc_() {}
+
+    // [first, last) must be strictly increasing by comp.
+    template <typename It>
+    FrozenTree(sorted_unique_tag, It first, It last, const Compare& comp = Compare())
+    : data_(nullptr), size_(0), comp_(comp), alloc_() {
+        size_type count = 0;
+        for (It it = first; it != last; ++it) {
+            ++count;
+        }
+        if (count == 0) {
+            return;
+        }
+        data_ = AllocTraits::allocate(alloc_, count + 1);
+        size_ = count;
+        fill_(first, 1);
+    }
+
+    FrozenTree(const FrozenTree& other) : data_(nullptr), size_(other.size_), comp_(other.comp_), alloc_(other.alloc_) {
+        if (size_ == 0) {
+            return;
+        }
+        data_ = AllocTraits::allocate(alloc_, size_ + 1);
+        for (size_type i = 1; i <= size_; ++i) {
+            AllocTraits::construct(alloc_, data_ + i, other.data_[i]);
+        }
+    }
+
+    FrozenTree(FrozenTree&& other) noexcept
+    : data_(other.data_), size_(other.size_), comp_(std::move(other.comp_)), alloc_(std::move(other.alloc_)) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    FrozenTree& operator=(FrozenTree other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(comp_, other.comp_);
+        std::swap(alloc_, other.alloc_);
+        return *this;
+    }
+
+    ~FrozenTree() {
+        if (data_ != nullptr) {
+            for (size_type i = 1; i <= size_; ++i) {
+                AllocTraits::destroy(alloc_, data_ + i);
+            }
+            AllocTraits::deallocate(alloc_, data_, size_ + 1);
+        }
+    }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> begin() const { return iterator<OrderType>(data_, beg_(OrderType{}), size_); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> end() const { return iterator<OrderType>(data_, 0, size_); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cbegin() const { return begin<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cend() const { return end<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rbegin() const { return reverse_iterator<OrderType>(end<OrderType>()); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rend() const { return reverse_iterator<OrderType>(begin<OrderType>()); }
+
+    size_type size() const { return size_; }
+
+    size_type max_size() const { return std::numeric_limits<size_type>::max(); }
+
+    bool empty() const { return size_ == 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> find(const_reference key) const { return find_<OrderType>(key); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find(const K& key) const { return find_<OrderType>(key); }
+
+    bool contains(const_reference key) const { return find(key) != end(); }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const { return find(key) != end(); }
+
+    size_type count(const_reference key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> lower_bound(const_reference key) const { return iterator<OrderType>(data_, lower_slot_(key), size_); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> lower_bound(const K& key) const { return iterator<OrderType>(data_, lower_slot_(key), size_); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> upper_bound(const_reference key) const { return iterator<OrderType>(data_, upper_slot_(key), size_); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> upper_bound(const K& key) const { return iterator<OrderType>(data_, upper_slot_(key), size_); }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const_reference key) const {
+        return std::make_pair(lower_bound<OrderType>(key), upper_bound<OrderType>(key));
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const K& key) const {
+        return std::make_pair(lower_bound<OrderType>(key), upper_bound<OrderType>(key));
+    }
+
+    key_compare key_comp() const { return comp_; }
+
+    value_compare value_comp() const { return comp_; }
+
+    allocator_type get_allocator() const { return alloc_; }
+
+private:
+    size_t beg_(inorder_tag) const { return (size_ != 0) ? leftmost_(1, size_) : 0; }
+
+    size_t beg_(preorder_tag) const { return (size_ != 0) ? 1 : 0; }
+
+    size_t beg_(postorder_tag) const { return beg_(inorder_tag{}); }
+
+    template <typename It>
+    void fill_(It& it, size_t slot) {
+        if (slot > size_) {
+            return;
+        }
+        fill_(it, 2 * slot);
+        AllocTraits::construct(alloc_, data_ + slot, *it);
+        ++it;
+        fill_(it, 2 * slot + 1);
+    }
+
+    void prefetch_(size_t slot) const {
+#if defined(__GNUC__)
+        __builtin_prefetch(data_ + std::min(kPrefetchStride * slot, size_));
+#endif
+    }
+
+    // The descent leaves slot = 2^depth * answer + (ones for every right turn below it);
+    // shifting out those trailing ones and one more bit recovers the answer (0 means end).
+    template <typename K>
+    size_t lower_slot_(const K& key) const {
+        size_t slot = 1;
+        while (slot <= size_) {
+            prefetch_(slot);
+            slot = 2 * slot + static_cast<size_t>(comp_(data_[slot], key));
+        }
+        return slot >> (std::countr_one(slot) + 1);
+    }
+
+    template <typename K>
+    size_t upper_slot_(const K& key) const {
+        size_t slot = 1;
+        while (slot <= size_) {
+            prefetch_(slot);
+            slot = 2 * slot + static_cast<size_t>(!comp_(key, data_[slot]));
+        }
+        return slot >> (std::countr_one(slot) + 1);
+    }
+
+    template <typename OrderType, typename K>
+    iterator<OrderType> find_(const K& key) const {
+        size_t slot = lower_slot_(key);
+        if (slot != 0 && !comp_(key, data_[slot])) {
+            return iterator<OrderType>(data_, slot, size_);
+        }
+        return end<OrderType>();
+    }
+};
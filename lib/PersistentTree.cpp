@@ -0,0 +1,583 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "BST.cpp"
+
+// Immutable version of a PersistentTree. Versions share nodes through reference counts, so
+// copying one is O(1) and a version stays valid, unchanged, for as long as it lives, also
+// while another thread keeps writing to the tree it came from. Nodes carry no parent links;
+// iterators find the next node with one descent from the root, O(log n) per step.
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class PersistentSnapshot {
+protected:
+    struct Node {
+        Node* left = nullptr;
+        Node* right = nullptr;
+        std::atomic<size_t> refs{1};
+        // Height of the subtree (leaf = 0), the tree is kept AVL-balanced.
+        signed char height_ = 0;
+        T data_;
+        template <typename... Args>
+        Node(Args&&... args) : data_(std::forward<Args>(args)...) {}
+    };
+
+    using NodeAlloc = std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using AllocTraits = std::allocator_traits<NodeAlloc>;
+
+    static constexpr bool is_transparent_ = requires { typename Compare::is_transparent; };
+
+    Node* root_;
+    size_t size_;
+    Compare comp_;
+    NodeAlloc alloc_;
+
+    template <typename OrderType = inorder_tag>
+    class base_iterator {
+    friend PersistentSnapshot;
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        using pointer_type = pointer;
+        using referense_type = reference;
+        using key_type = const T;
+
+        base_iterator() = default;
+        base_iterator(const base_iterator&) = default;
+        base_iterator& operator=(const base_iterator&) = default;
+
+        bool operator==(const base_iterator& other) const { return ptr_ == other.ptr_; }
+        bool operator!=(const base_iterator& other) const { return ptr_ != other.ptr_; }
+
+        referense_type operator*() const { return ptr_->data_; }
+        pointer_type operator->() const { return &ptr_->data_; }
+
+        base_iterator& operator++() {
+            return increment(OrderType{});
+        }
+
+        base_iterator& operator--() {
+            return decrement(OrderType{});
+        }
+
+        base_iterator operator++(int) {
+            auto copy = *this;
+            ++(*this);
+            return copy;
+        }
+
+        base_iterator operator--(int) {
+            auto copy = *this;
+            --(*this);
+            return copy;
+        }
+
+        base_iterator& increment(inorder_tag) {
+            if (ptr_->right != nullptr) {
+                ptr_ = leftmost_(ptr_->right);
+                return *this;
+            }
+            const Node* next = nullptr;
+            owner_->descend_(ptr_, [&](const Node* elem, bool go_left) { next = go_left ? elem : next; });
+            ptr_ = next;
+            return *this;
+        }
+
+        base_iterator& decrement(inorder_tag) {
+            if (ptr_ == nullptr) {
+                ptr_ = rightmost_(owner_->root_);
+                return *this;
+            }
+            if (ptr_->left != nullptr) {
+                ptr_ = rightmost_(ptr_->left);
+                return *this;
+            }
+            const Node* prev = nullptr;
+            owner_->descend_(ptr_, [&](const Node* elem, bool go_left) { prev = go_left ? prev : elem; });
+            ptr_ = prev;
+            return *this;
+        }
+
+        // A node without children continues at the right child of the nearest ancestor
+        // that has one and holds it in its left subtree.
+        base_iterator& increment(preorder_tag) {
+            if (ptr_->left != nullptr || ptr_->right != nullptr) {
+                ptr_ = (ptr_->left != nullptr) ? ptr_->left : ptr_->right;
+                return *this;
+            }
+            const Node* next = nullptr;
+            owner_->descend_(ptr_, [&](const Node* elem, bool go_left) {
+                next = (go_left && elem->right != nullptr) ? elem->right : next;
+            });
+            ptr_ = next;
+            return *this;
+        }
+
+        base_iterator& decrement(preorder_tag) {
+            if (ptr_ == nullptr) {
+                ptr_ = (owner_->root_ != nullptr) ? deepest_last_(owner_->root_) : nullptr;
+                return *this;
+            }
+            const Node* par = owner_->parent_(ptr_);
+            if (par == nullptr || par->left == ptr_ || par->left == nullptr) {
+                ptr_ = par;
+            } else {
+                ptr_ = deepest_last_(par->left);
+            }
+            return *this;
+        }
+
+        base_iterator& increment(postorder_tag) {
+            const Node* par = owner_->parent_(ptr_);
+            if (par == nullptr || par->right == ptr_ || par->right == nullptr) {
+                ptr_ = par;
+            } else {
+                ptr_ = deepest_first_(par->right);
+            }
+            return *this;
+        }
+
+        // Mirrors increment(preorder_tag): postorder backwards is preorder with sides swapped.
+        base_iterator& decrement(postorder_tag) {
+            if (ptr_ == nullptr) {
+                ptr_ = owner_->root_;
+                return *this;
+            }
+            if (ptr_->left != nullptr || ptr_->right != nullptr) {
+                ptr_ = (ptr_->right != nullptr) ? ptr_->right : ptr_->left;
+                return *this;
+            }
+            const Node* prev = nullptr;
+            owner_->descend_(ptr_, [&](const Node* elem, bool go_left) {
+                prev = (!go_left && elem->left != nullptr) ? elem->left : prev;
+            });
+            ptr_ = prev;
+            return *this;
+        }
+
+    private:
+        const PersistentSnapshot* owner_ = nullptr;
+        const Node* ptr_ = nullptr;
+
+        base_iterator(const PersistentSnapshot* owner, const Node* ptr) : owner_(owner), ptr_(ptr) {}
+    };
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using const_iterator = base_iterator<OrderType>;
+
+    template <typename OrderType = inorder_tag>
+    using reverse_iterator = std::reverse_iterator<iterator<OrderType>>;
+
+    template <typename OrderType = inorder_tag>
+    using const_reverse_iterator = std::reverse_iterator<const_iterator<OrderType>>;
+
+    using value_type = T;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = size_t;
+
+    using key_type = T;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using allocator_type = Alloc;
+
+    PersistentSnapshot() : root_(nullptr), size_(0), comp_(), alloc_() {}
+
+    PersistentSnapshot(const PersistentSnapshot& other)
+    : root_(retain_(other.root_)), size_(other.size_), comp_(other.comp_), alloc_(other.alloc_) {}
+
+    PersistentSnapshot(PersistentSnapshot&& other) noexcept
+    : root_(other.root_), size_(other.size_), comp_(std::move(other.comp_)), alloc_(std::move(other.alloc_)) {
+        other.root_ = nullptr;
+        other.size_ = 0;
+    }
+
+    PersistentSnapshot& operator=(PersistentSnapshot other) noexcept {
+        std::swap(root_, other.root_);
+        std::swap(size_, other.size_);
+        std::swap(comp_, other.comp_);
+        std::swap(alloc_, other.alloc_);
+        return *this;
+    }
+
+    ~PersistentSnapshot() { release_(root_); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> begin() const { return iterator<OrderType>(this, beg_(OrderType{})); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> end() const { return iterator<OrderType>(this, nullptr); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cbegin() const { return begin<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    const_iterator<OrderType> cend() const { return end<OrderType>(); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rbegin() const { return reverse_iterator<OrderType>(end<OrderType>()); }
+
+    template <typename OrderType = inorder_tag>
+    reverse_iterator<OrderType> rend() const { return reverse_iterator<OrderType>(begin<OrderType>()); }
+
+    size_type size() const { return size_; }
+
+    size_type max_size() const { return std::numeric_limits<size_type>::max(); }
+
+    bool empty() const { return size_ == 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> find(const_reference key) const { return iterator<OrderType>(this, find_node_(key)); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> find(const K& key) const { return iterator<OrderType>(this, find_node_(key)); }
+
+    bool contains(const_reference key) const { return find_node_(key) != nullptr; }
+
+    template <typename K>
+    requires is_transparent_
+    bool contains(const K& key) const { return find_node_(key) != nullptr; }
+
+    size_type count(const_reference key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename K>
+    requires is_transparent_
+    size_type count(const K& key) const { return (contains(key)) ? 1 : 0; }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> lower_bound(const_reference key) const { return iterator<OrderType>(this, bound_<true>(key)); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> lower_bound(const K& key) const { return iterator<OrderType>(this, bound_<true>(key)); }
+
+    template <typename OrderType = inorder_tag>
+    iterator<OrderType> upper_bound(const_reference key) const { return iterator<OrderType>(this, bound_<false>(key)); }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    iterator<OrderType> upper_bound(const K& key) const { return iterator<OrderType>(this, bound_<false>(key)); }
+
+    template <typename OrderType = inorder_tag>
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const_reference key) const {
+        return std::make_pair(lower_bound<OrderType>(key), upper_bound<OrderType>(key));
+    }
+
+    template <typename OrderType = inorder_tag, typename K>
+    requires is_transparent_
+    std::pair<iterator<OrderType>, iterator<OrderType>> equal_range(const K& key) const {
+        return std::make_pair(lower_bound<OrderType>(key), upper_bound<OrderType>(key));
+    }
+
+    key_compare key_comp() const { return comp_; }
+
+    value_compare value_comp() const { return comp_; }
+
+    allocator_type get_allocator() const { return alloc_; }
+
+protected:
+    iterator<> iterator_at_(const Node* elem) const { return iterator<>(this, elem); }
+
+    static const Node* leftmost_(const Node* elem) {
+        while (elem->left != nullptr) {
+            elem = elem->left;
+        }
+        return elem;
+    }
+
+    static const Node* rightmost_(const Node* elem) {
+        while (elem != nullptr && elem->right != nullptr) {
+            elem = elem->right;
+        }
+        return elem;
+    }
+
+    // First node of the subtree in postorder: keep to the left child, or the right one if it is alone.
+    static const Node* deepest_first_(const Node* elem) {
+        while (elem->left != nullptr || elem->right != nullptr) {
+            elem = (elem->left != nullptr) ? elem->left : elem->right;
+        }
+        return elem;
+    }
+
+    static const Node* deepest_last_(const Node* elem) {
+        while (elem->left != nullptr || elem->right != nullptr) {
+            elem = (elem->right != nullptr) ? elem->right : elem->left;
+        }
+        return elem;
+    }
+
+    const Node* beg_(inorder_tag) const { return (root_ != nullptr) ? leftmost_(root_) : nullptr; }
+
+    const Node* beg_(preorder_tag) const { return root_; }
+
+    const Node* beg_(postorder_tag) const { return (root_ != nullptr) ? deepest_first_(root_) : nullptr; }
+
+    // Calls visit(node, went_left) for every proper ancestor of target, from the root down.
+    template <typename Visit>
+    void descend_(const Node* target, Visit&& visit) const {
+        const Node* now = root_;
+        while (now != target) {
+            bool go_left = comp_(target->data_, now->data_);
+            visit(now, go_left);
+            now = go_left ? now->left : now->right;
+        }
+    }
+
+    const Node* parent_(const Node* target) const {
+        const Node* par = nullptr;
+        descend_(target, [&](const Node* elem, bool) { par = elem; });
+        return par;
+    }
+
+    template <typename K>
+    const Node* find_node_(const K& key) const {
+        const Node* now = root_;
+        while (now != nullptr) {
+            if (comp_(key, now->data_)) {
+                now = now->left;
+            } else if (comp_(now->data_, key)) {
+                now = now->right;
+            } else {
+                return now;
+            }
+        }
+        return nullptr;
+    }
+
+    template <bool Inclusive, typename K>
+    const Node* bound_(const K& key) const {
+        const Node* best = nullptr;
+        const Node* now = root_;
+        while (now != nullptr) {
+            bool go_left = Inclusive ? !comp_(now->data_, key) : comp_(key, now->data_);
+            best = go_left ? now : best;
+            now = go_left ? now->left : now->right;
+        }
+        return best;
+    }
+
+    static Node* retain_(Node* elem) {
+        if (elem != nullptr) {
+            elem->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        return elem;
+    }
+
+    // Drops one reference; a node freed this way releases its children in turn.
+    void release_(Node* elem) {
+        while (elem != nullptr && elem->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release_(elem->left);
+            Node* right = elem->right;
+            AllocTraits::destroy(alloc_, elem);
+            alloc_.deallocate(elem, 1);
+            elem = right;
+        }
+    }
+};
+
+// Versioned search tree. insert and erase copy the O(log n) nodes on the search path that are
+// shared with a snapshot and modify unshared nodes in place; snapshot() is O(1).
+// Iterators of the tree itself are invalidated by insert and erase, those of snapshots are not.
+// A tree and its snapshots may be used from different threads, the tree from one at a time.
+template <typename T, typename Compare = std::less<T>, typename Alloc = std::allocator<T>>
+class PersistentTree: public PersistentSnapshot<T, Compare, Alloc> {
+private:
+    using Base = PersistentSnapshot<T, Compare, Alloc>;
+    using typename Base::Node;
+    using typename Base::AllocTraits;
+    using Base::root_;
+    using Base::size_;
+    using Base::comp_;
+    using Base::alloc_;
+
+public:
+    template <typename OrderType = inorder_tag>
+    using iterator = typename Base::template iterator<OrderType>;
+
+    using typename Base::value_type;
+    using typename Base::const_reference;
+    using typename Base::size_type;
+    using snapshot_type = Base;
+
+    PersistentTree() = default;
+
+    PersistentTree(const std::initializer_list<value_type>& il) {
+        insert(il);
+    }
+
+    // O(1): the new version shares every node with this one.
+    snapshot_type snapshot() const { return static_cast<const Base&>(*this); }
+
+    std::pair<iterator<>, bool> insert(const_reference value) { return emplace_(value); }
+
+    std::pair<iterator<>, bool> insert(value_type&& value) { return emplace_(std::move(value)); }
+
+    void insert(const std::initializer_list<value_type>& il) {
+        for (const_reference value : il) {
+            insert(value);
+        }
+    }
+
+    size_type erase(const_reference key) { return erase_key_(key); }
+
+    template <typename K>
+    requires Base::is_transparent_
+    size_type erase(const K& key) { return erase_key_(key); }
+
+    void clear() {
+        this->release_(root_);
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+private:
+    template <typename... Args>
+    Node* create_node_(Args&&... args) {
+        Node* val = alloc_.allocate(1);
+        AllocTraits::construct(alloc_, val, std::forward<Args>(args)...);
+        return val;
+    }
+
+    // Takes over the reference of the link to elem and returns a node that only this link uses.
+    Node* own_(Node* elem) {
+        if (elem->refs.load(std::memory_order_acquire) == 1) {
+            return elem;
+        }
+        Node* copy = create_node_(elem->data_);
+        copy->left = Base::retain_(elem->left);
+        copy->right = Base::retain_(elem->right);
+        copy->height_ = elem->height_;
+        this->release_(elem);
+        return copy;
+    }
+
+    static signed char height_(const Node* elem) { return (elem != nullptr) ? elem->height_ : -1; }
+
+    static void recalc_(Node* elem) { elem->height_ = 1 + std::max(height_(elem->left), height_(elem->right)); }
+
+    Node* rotate_left_(Node* elem) {
+        Node* sub = own_(elem->right);
+        elem->right = sub->left;
+        sub->left = elem;
+        recalc_(elem);
+        recalc_(sub);
+        return sub;
+    }
+
+    Node* rotate_right_(Node* elem) {
+        Node* sub = own_(elem->left);
+        elem->left = sub->right;
+        sub->right = elem;
+        recalc_(elem);
+        recalc_(sub);
+        return sub;
+    }
+
+    Node* rebalance_(Node* elem) {
+        recalc_(elem);
+        int diff = height_(elem->left) - height_(elem->right);
+        if (diff > 1) {
+            if (height_(elem->left->left) < height_(elem->left->right)) {
+                elem->left = rotate_left_(own_(elem->left));
+            }
+            return rotate_right_(elem);
+        }
+        if (diff < -1) {
+            if (height_(elem->right->right) < height_(elem->right->left)) {
+                elem->right = rotate_right_(own_(elem->right));
+            }
+            return rotate_left_(elem);
+        }
+        return elem;
+    }
+
+    // value is only read before the new node is built from it, which is reported in created.
+    template <typename Arg>
+    Node* insert_(Node* elem, Arg&& value, Node*& created) {
+        if (elem == nullptr) {
+            created = create_node_(std::forward<Arg>(value));
+            return created;
+        }
+        elem = own_(elem);
+        if (comp_(value, elem->data_)) {
+            elem->left = insert_(elem->left, std::forward<Arg>(value), created);
+        } else {
+            elem->right = insert_(elem->right, std::forward<Arg>(value), created);
+        }
+        return rebalance_(elem);
+    }
+
+    // Detaches the smallest node of the subtree into min, which the caller then owns.
+    Node* remove_min_(Node* elem, Node*& min) {
+        elem = own_(elem);
+        if (elem->left == nullptr) {
+            min = elem;
+            Node* right = elem->right;
+            elem->right = nullptr;
+            return right;
+        }
+        elem->left = remove_min_(elem->left, min);
+        return rebalance_(elem);
+    }
+
+    template <typename K>
+    Node* erase_(Node* elem, const K& key) {
+        elem = own_(elem);
+        if (comp_(key, elem->data_)) {
+            elem->left = erase_(elem->left, key);
+        } else if (comp_(elem->data_, key)) {
+            elem->right = erase_(elem->right, key);
+        } else {
+            Node* left = elem->left;
+            Node* right = elem->right;
+            elem->left = nullptr;
+            elem->right = nullptr;
+            this->release_(elem);
+            if (left == nullptr || right == nullptr) {
+                return (left != nullptr) ? left : right;
+            }
+            Node* min;
+            right = remove_min_(right, min);
+            min->left = left;
+            min->right = right;
+            elem = min;
+        }
+        return rebalance_(elem);
+    }
+
+    template <typename Arg>
+    std::pair<iterator<>, bool> emplace_(Arg&& value) {
+        if (const Node* found = this->find_node_(value); found != nullptr) {
+            return {this->iterator_at_(found), false};
+        }
+        Node* created = nullptr;
+        root_ = insert_(root_, std::forward<Arg>(value), created);
+        ++size_;
+        return {this->iterator_at_(created), true};
+    }
+
+    template <typename K>
+    size_type erase_key_(const K& key) {
+        if (!this->contains(key)) {
+            return 0;
+        }
+        root_ = erase_(root_, key);
+        --size_;
+        return 1;
+    }
+};
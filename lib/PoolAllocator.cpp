@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Slots of one size and alignment in chunks of ChunkNodes, one pool per (size, alignment) in
+// an arena; PoolAllocator hands them out and knows the type of the objects.
+template <size_t ChunkNodes>
+class PoolArena {
+private:
+    struct Slot {
+        Slot* next;
+    };
+
+public:
+    class Pool {
+    public:
+        Pool(size_t slot_size, size_t align) : slot_size_(slot_size), align_(align) {}
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        ~Pool() { release(); }
+
+        void* allocate() {
+            if (free_list_ != nullptr) {
+                Slot* slot = free_list_;
+                free_list_ = slot->next;
+                return slot;
+            }
+            if (used_ == ChunkNodes) {
+                chunks_.push_back(::operator new(slot_size_ * ChunkNodes, std::align_val_t(align_)));
+                used_ = 0;
+            }
+            return static_cast<unsigned char*>(chunks_.back()) + slot_size_ * used_++;
+        }
+
+        void deallocate(void* ptr) {
+            Slot* slot = static_cast<Slot*>(ptr);
+            slot->next = free_list_;
+            free_list_ = slot;
+        }
+
+        void release() {
+            for (void* chunk : chunks_) {
+                ::operator delete(chunk, std::align_val_t(align_));
+            }
+            chunks_.clear();
+            free_list_ = nullptr;
+            used_ = ChunkNodes;
+        }
+
+    private:
+        friend PoolArena;
+
+        size_t slot_size_;
+        size_t align_;
+        std::vector<void*> chunks_;
+        Slot* free_list_ = nullptr;
+        size_t used_ = ChunkNodes;
+    };
+
+    // Number of single objects handed out from any pool of the arena.
+    size_t live = 0;
+
+    template <typename U>
+    Pool* pool_for() {
+        size_t align = std::max(alignof(U), alignof(Slot));
+        size_t slot_size = (std::max(sizeof(U), sizeof(Slot)) + align - 1) / align * align;
+        for (const auto& pool : pools_) {
+            if (pool->slot_size_ == slot_size && pool->align_ == align) {
+                return pool.get();
+            }
+        }
+        pools_.push_back(std::make_unique<Pool>(slot_size, align));
+        return pools_.back().get();
+    }
+
+    void release() {
+        for (const auto& pool : pools_) {
+            pool->release();
+        }
+        live = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<Pool>> pools_;
+};
+
+// Carves single objects out of chunks of ChunkNodes slots. Freed slots go to a free list
+// and are reused by the next allocate(1); release() drops every chunk at once.
+// An allocator, its copies and its rebound copies share one PoolArena, so a container that
+// rebinds it to its node type still allocates from the arena it was given, and the
+// allocators compare equal.
+template <typename T, size_t ChunkNodes = 1024>
+class PoolAllocator {
+private:
+    template <typename, size_t>
+    friend class PoolAllocator;
+
+    using Arena = PoolArena<ChunkNodes>;
+    using Pool = typename Arena::Pool;
+
+    std::shared_ptr<Arena> arena_;
+    Pool* pool_;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, ChunkNodes>;
+    };
+
+    PoolAllocator() : arena_(std::make_shared<Arena>()), pool_(arena_->template pool_for<T>()) {}
+
+    PoolAllocator(const PoolAllocator&) = default;
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, ChunkNodes>& other)
+    : arena_(other.arena_), pool_(arena_->template pool_for<T>()) {}
+
+    T* allocate(size_type n) {
+        if (n == 1) {
+            ++arena_->live;
+            return static_cast<T*>(pool_->allocate());
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_type n) {
+        if (n == 1) {
+            pool_->deallocate(ptr);
+            --arena_->live;
+        } else {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    // Frees every chunk of the arena shared by this allocator and its (rebound) copies.
+    // Objects still living in the arena must be destroyed beforehand.
+    void release() { arena_->release(); }
+
+    // Number of single-object allocations currently handed out by the shared arena, of any type.
+    size_type in_use() const { return arena_->live; }
+
+    PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, ChunkNodes>& other) const { return arena_ == other.arena_; }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, ChunkNodes>& other) const { return arena_ != other.arena_; }
+};
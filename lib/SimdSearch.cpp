@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SIMD_SEARCH_X86 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_SEARCH_NEON 1
+#endif
+
+// Branch-free rank of a key inside a sorted block of arithmetic keys, ordered by std::less.
+// count<false> is the number of keys less than key (lower bound index),
+// count<true> is the number of keys not greater than key (upper bound index).
+namespace simd_search {
+
+template <typename T>
+inline constexpr bool supported_v = std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>
+                                 || std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t>
+                                 || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template <bool Inclusive, typename T>
+size_t count_scalar(const T* keys, size_t n, T key) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if constexpr (Inclusive) {
+            count += !(key < keys[i]);
+        } else {
+            count += keys[i] < key;
+        }
+    }
+    return count;
+}
+
+#if defined(SIMD_SEARCH_X86) && defined(__GNUC__)
+
+template <bool Inclusive, typename T>
+__attribute__((target("avx2"))) size_t count_avx2(const T* keys, size_t n, T key) {
+    size_t i = 0;
+    size_t count = 0;
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        const __m256i bias = _mm256_set1_epi32(std::is_signed_v<T> ? 0 : INT32_MIN);
+        const __m256i probe = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(key)), bias);
+        for (; i + 8 <= n; i += 8) {
+            __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            if constexpr (Inclusive) {
+                __m256i greater = _mm256_cmpgt_epi32(block, probe);
+                count += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(greater)));
+            } else {
+                __m256i less = _mm256_cmpgt_epi32(probe, block);
+                count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+            }
+        }
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        const __m256i bias = _mm256_set1_epi64x(std::is_signed_v<T> ? 0 : INT64_MIN);
+        const __m256i probe = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(key)), bias);
+        for (; i + 4 <= n; i += 4) {
+            __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            if constexpr (Inclusive) {
+                __m256i greater = _mm256_cmpgt_epi64(block, probe);
+                count += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(greater)));
+            } else {
+                __m256i less = _mm256_cmpgt_epi64(probe, block);
+                count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+            }
+        }
+    } else if constexpr (std::is_same_v<T, float>) {
+        const __m256 probe = _mm256_set1_ps(key);
+        for (; i + 8 <= n; i += 8) {
+            __m256 block = _mm256_loadu_ps(keys + i);
+            __m256 mask = _mm256_cmp_ps(block, probe, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_ps(mask));
+        }
+    } else {
+        const __m256d probe = _mm256_set1_pd(key);
+        for (; i + 4 <= n; i += 4) {
+            __m256d block = _mm256_loadu_pd(keys + i);
+            __m256d mask = _mm256_cmp_pd(block, probe, Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_pd(mask));
+        }
+    }
+    return count + count_scalar<Inclusive>(keys + i, n - i, key);
+}
+
+// SSE2 is part of x86-64, so only 64-bit integers have no vector path here.
+template <bool Inclusive, typename T>
+size_t count_sse2(const T* keys, size_t n, T key) {
+    size_t i = 0;
+    size_t count = 0;
+    if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        const __m128i bias = _mm_set1_epi32(std::is_signed_v<T> ? 0 : INT32_MIN);
+        const __m128i probe = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(key)), bias);
+        for (; i + 4 <= n; i += 4) {
+            __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+            if constexpr (Inclusive) {
+                __m128i greater = _mm_cmpgt_epi32(block, probe);
+                count += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(greater)));
+            } else {
+                __m128i less = _mm_cmpgt_epi32(probe, block);
+                count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+            }
+        }
+    } else if constexpr (std::is_same_v<T, float>) {
+        const __m128 probe = _mm_set1_ps(key);
+        for (; i + 4 <= n; i += 4) {
+            __m128 block = _mm_loadu_ps(keys + i);
+            __m128 mask = Inclusive ? _mm_cmple_ps(block, probe) : _mm_cmplt_ps(block, probe);
+            count += __builtin_popcount(_mm_movemask_ps(mask));
+        }
+    } else if constexpr (std::is_same_v<T, double>) {
+        const __m128d probe = _mm_set1_pd(key);
+        for (; i + 2 <= n; i += 2) {
+            __m128d block = _mm_loadu_pd(keys + i);
+            __m128d mask = Inclusive ? _mm_cmple_pd(block, probe) : _mm_cmplt_pd(block, probe);
+            count += __builtin_popcount(_mm_movemask_pd(mask));
+        }
+    }
+    return count + count_scalar<Inclusive>(keys + i, n - i, key);
+}
+
+#elif defined(SIMD_SEARCH_NEON)
+
+template <bool Inclusive, typename T>
+size_t count_neon(const T* keys, size_t n, T key) {
+    size_t i = 0;
+    size_t count = 0;
+    if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> || std::is_same_v<T, float>) {
+        for (; i + 4 <= n; i += 4) {
+            uint32x4_t mask;
+            if constexpr (std::is_same_v<T, int32_t>) {
+                mask = Inclusive ? vcleq_s32(vld1q_s32(keys + i), vdupq_n_s32(key))
+                                 : vcltq_s32(vld1q_s32(keys + i), vdupq_n_s32(key));
+            } else if constexpr (std::is_same_v<T, uint32_t>) {
+                mask = Inclusive ? vcleq_u32(vld1q_u32(keys + i), vdupq_n_u32(key))
+                                 : vcltq_u32(vld1q_u32(keys + i), vdupq_n_u32(key));
+            } else {
+                mask = Inclusive ? vcleq_f32(vld1q_f32(keys + i), vdupq_n_f32(key))
+                                 : vcltq_f32(vld1q_f32(keys + i), vdupq_n_f32(key));
+            }
+            count += vaddvq_u32(vshrq_n_u32(mask, 31));
+        }
+    } else {
+        for (; i + 2 <= n; i += 2) {
+            uint64x2_t mask;
+            if constexpr (std::is_same_v<T, int64_t>) {
+                mask = Inclusive ? vcleq_s64(vld1q_s64(keys + i), vdupq_n_s64(key))
+                                 : vcltq_s64(vld1q_s64(keys + i), vdupq_n_s64(key));
+            } else if constexpr (std::is_same_v<T, uint64_t>) {
+                mask = Inclusive ? vcleq_u64(vld1q_u64(keys + i), vdupq_n_u64(key))
+                                 : vcltq_u64(vld1q_u64(keys + i), vdupq_n_u64(key));
+            } else {
+                mask = Inclusive ? vcleq_f64(vld1q_f64(keys + i), vdupq_n_f64(key))
+                                 : vcltq_f64(vld1q_f64(keys + i), vdupq_n_f64(key));
+            }
+            count += vaddvq_u64(vshrq_n_u64(mask, 63));
+        }
+    }
+    return count + count_scalar<Inclusive>(keys + i, n - i, key);
+}
+
+#endif
+
+template <bool Inclusive, typename T>
+size_t count(const T* keys, size_t n, T key) {
+#if defined(SIMD_SEARCH_X86) && defined(__GNUC__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        return count_avx2<Inclusive>(keys, n, key);
+    }
+    return count_sse2<Inclusive>(keys, n, key);
+#elif defined(SIMD_SEARCH_NEON)
+    return count_neon<Inclusive>(keys, n, key);
+#else
+    return count_scalar<Inclusive>(keys, n, key);
+#endif
+}
+
+}
@@ -1,6 +1,25 @@
 #include <lib/BST.cpp>
+#include <lib/PoolAllocator.cpp>
+#include <lib/FrozenTree.cpp>
+#include <lib/Reclaimer.cpp>
+#include <lib/BSTMap.cpp>
 #include <gtest/gtest.h>
 #include <vector>
+#include <set>
+#include <map>
+#include <random>
+#include <string_view>
+#include <atomic>
+#include <ranges>
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> Collect(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    for (auto it = tree.template begin<OrderType>(); it != tree.template end<OrderType>(); ++it) {
+        ans.push_back(*it);
+    }
+    return ans;
+}
 
 
 TEST(BSTTestSuite, InOrderDefault) {
@@ -56,7 +75,7 @@ TEST(BSTTestSuite, PreOrder) {
         ans.push_back(*(it1));
         ++it1;
     }
-    std::vector<int> ans_correct{6, 1, 4, 5, 10};
+    std::vector<int> ans_correct{6, 4, 1, 5, 10};
     ASSERT_TRUE(ans == ans_correct);
 }
 
@@ -74,7 +93,7 @@ TEST(BSTTestSuite, PostOrder) {
         ans.push_back(*(it1));
         ++it1;
     }
-    std::vector<int> ans_correct{5, 4, 1, 10, 6};
+    std::vector<int> ans_correct{1, 5, 4, 10, 6};
     ASSERT_TRUE(ans == ans_correct);
 }
 
@@ -211,4 +230,1093 @@ TEST(BSTTestSuite, RefEraseTest) {
     ASSERT_EQ(ans, ans_correct);
 }
 
+TEST(BSTTestSuite, UnbalancedPreOrder) {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, unbalanced_tag> a = {6, 1, 10, 4, 5};
+    std::vector<int> ans = Collect<preorder_tag>(a);
+    std::vector<int> ans_correct{6, 1, 4, 5, 10};
+    ASSERT_EQ(ans, ans_correct);
+}
+
+TEST(BSTTestSuite, RedBlackSortedInsert) {
+    BinarySearchTree<int> a = {1, 2, 3, 4, 5, 6, 7};
+    std::vector<int> ans = Collect<preorder_tag>(a);
+    std::vector<int> ans_correct{2, 1, 4, 3, 6, 5, 7};
+    ASSERT_EQ(ans, ans_correct);
+}
+
+TEST(BSTTestSuite, AVLSortedInsert) {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, avl_tag> a = {1, 2, 3, 4, 5, 6, 7};
+    std::vector<int> ans = Collect<preorder_tag>(a);
+    std::vector<int> ans_correct{4, 2, 1, 3, 6, 5, 7};
+    ASSERT_EQ(ans, ans_correct);
+}
+
+// Walks the tree forward and back in OrderType; a walk that never reaches the end fails the
+// step bound instead of hanging.
+template <typename OrderType, typename Tree>
+void CheckWalk(const Tree& tree, const std::vector<typename Tree::value_type>& expected) {
+    std::vector<typename Tree::value_type> forward;
+    for (auto it = tree.template begin<OrderType>(); it != tree.template end<OrderType>(); ++it) {
+        ASSERT_LE(forward.size(), expected.size());
+        forward.push_back(*it);
+    }
+    ASSERT_EQ(forward, expected);
+    std::vector<typename Tree::value_type> backward;
+    for (auto it = tree.template rbegin<OrderType>(); it != tree.template rend<OrderType>(); ++it) {
+        ASSERT_LE(backward.size(), expected.size());
+        backward.push_back(*it);
+    }
+    ASSERT_EQ(backward, std::vector<typename Tree::value_type>(expected.rbegin(), expected.rend()));
+    ASSERT_EQ(std::ranges::distance(tree.template view<OrderType>()), std::ssize(expected));
+}
+
+TEST(BSTTestSuite, PreOrderWithoutLeftSubtree) {
+    BinarySearchTree<int> empty;
+    CheckWalk<preorder_tag>(empty, {});
+    BinarySearchTree<int> one = {1};
+    CheckWalk<preorder_tag>(one, {1});
+    CheckWalk<postorder_tag>(one, {1});
+    BinarySearchTree<int> two = {1, 2};
+    CheckWalk<preorder_tag>(two, {1, 2});
+    CheckWalk<inorder_tag>(two, {1, 2});
+    CheckWalk<postorder_tag>(two, {2, 1});
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, unbalanced_tag> chain = {1, 2, 3, 4, 5};
+    CheckWalk<preorder_tag>(chain, {1, 2, 3, 4, 5});
+    CheckWalk<postorder_tag>(chain, {5, 4, 3, 2, 1});
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, unbalanced_tag> right_heavy = {1, 3, 2, 4};
+    CheckWalk<preorder_tag>(right_heavy, {1, 3, 2, 4});
+    CheckWalk<postorder_tag>(right_heavy, {2, 4, 3, 1});
+}
+
+template <typename Balance>
+void RandomInsertErase() {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance> a;
+    std::set<int> ref;
+    std::mt19937 gen(42);
+    for (int i = 0; i < 5000; ++i) {
+        int key = gen() % 1000;
+        if (gen() % 3 == 0) {
+            ASSERT_EQ(a.erase(key), ref.erase(key));
+        } else {
+            ASSERT_EQ(a.insert(key).second, ref.insert(key).second);
+        }
+        ASSERT_EQ(a.size(), ref.size());
+    }
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>(ref.begin(), ref.end()));
+    ASSERT_EQ(Collect<preorder_tag>(a).size(), ref.size());
+    ASSERT_EQ(Collect<postorder_tag>(a).size(), ref.size());
+}
+
+TEST(BSTTestSuite, RandomInsertEraseRedBlack) {
+    RandomInsertErase<red_black_tag>();
+}
+
+TEST(BSTTestSuite, RandomInsertEraseAVL) {
+    RandomInsertErase<avl_tag>();
+}
+
+TEST(BSTTestSuite, RandomInsertEraseUnbalanced) {
+    RandomInsertErase<unbalanced_tag>();
+}
+
+template <typename Balance>
+void OrderStatistics() {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance, order_statistics_tag> a;
+    std::set<int> ref;
+    std::mt19937 gen(7);
+    for (int i = 0; i < 3000; ++i) {
+        int key = gen() % 500;
+        if (gen() % 3 == 0) {
+            a.erase(key);
+            ref.erase(key);
+        } else {
+            a.insert(key);
+            ref.insert(key);
+        }
+    }
+    std::vector<int> sorted(ref.begin(), ref.end());
+    for (size_t k = 0; k < sorted.size(); ++k) {
+        ASSERT_EQ(*a.nth(k), sorted[k]);
+    }
+    ASSERT_TRUE(a.nth(sorted.size()) == a.end());
+    for (int key = -1; key <= 500; ++key) {
+        size_t less = std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin();
+        ASSERT_EQ(a.rank(key), less);
+        size_t upto = std::upper_bound(sorted.begin(), sorted.end(), key + 10) - sorted.begin();
+        ASSERT_EQ(a.count_range(key, key + 10), upto - less);
+    }
+    ASSERT_EQ(a.count_range(10, 5), 0);
+    using std::distance;
+    ASSERT_EQ(distance(a.begin(), a.end()), static_cast<std::ptrdiff_t>(sorted.size()));
+    ASSERT_EQ(distance(a.lower_bound(100), a.lower_bound(400)),
+              std::lower_bound(sorted.begin(), sorted.end(), 400) - std::lower_bound(sorted.begin(), sorted.end(), 100));
+    ASSERT_EQ(distance(a.end(), a.begin()), -static_cast<std::ptrdiff_t>(sorted.size()));
+    auto b = a;
+    ASSERT_EQ(*b.nth(sorted.size() / 2), sorted[sorted.size() / 2]);
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance, order_statistics_tag> c;
+    c.assign_sorted(sorted.begin(), sorted.end());
+    ASSERT_EQ(c.rank(250), a.rank(250));
+    ASSERT_EQ(*c.nth(17), sorted[17]);
+}
+
+TEST(BSTTestSuite, OrderStatisticsRedBlack) {
+    OrderStatistics<red_black_tag>();
+}
+
+TEST(BSTTestSuite, OrderStatisticsAVL) {
+    OrderStatistics<avl_tag>();
+}
+
+TEST(BSTTestSuite, OrderStatisticsUnbalanced) {
+    OrderStatistics<unbalanced_tag>();
+}
+
+struct concat_monoid {
+    using value_type = std::string;
+    static value_type identity() { return ""; }
+    static value_type lift(const std::string& value) { return value; }
+    static value_type combine(const value_type& a, const value_type& b) { return a + b; }
+};
+
+template <typename Balance>
+void Aggregates() {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance, sum_monoid<long long>> sums;
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance, min_monoid<int>> mins;
+    std::set<int> ref;
+    std::mt19937 gen(11);
+    for (int i = 0; i < 2000; ++i) {
+        int key = gen() % 400;
+        if (gen() % 3 == 0) {
+            sums.erase(key);
+            mins.erase(key);
+            ref.erase(key);
+        } else {
+            sums.insert(key);
+            mins.insert(key);
+            ref.insert(key);
+        }
+    }
+    for (int lo = -5; lo < 405; lo += 7) {
+        for (int hi = lo - 3; hi < 410; hi += 13) {
+            long long sum = 0;
+            int min = std::numeric_limits<int>::max();
+            for (auto it = ref.lower_bound(lo); it != ref.end() && *it <= hi; ++it) {
+                sum += *it;
+                min = std::min(min, *it);
+            }
+            ASSERT_EQ(sums.aggregate(lo, hi), sum);
+            ASSERT_EQ(mins.aggregate(lo, hi), min);
+        }
+    }
+    long long total = 0;
+    for (int key : ref) {
+        total += key;
+    }
+    ASSERT_EQ(sums.aggregate(), total);
+    ASSERT_EQ(sums.rank(200), mins.rank(200));
+}
+
+TEST(BSTTestSuite, AggregatesRedBlack) {
+    Aggregates<red_black_tag>();
+}
+
+TEST(BSTTestSuite, AggregatesAVL) {
+    Aggregates<avl_tag>();
+}
+
+TEST(BSTTestSuite, AggregatesKeepOrder) {
+    BinarySearchTree<std::string, std::less<std::string>, std::allocator<std::string>, red_black_tag, concat_monoid> a;
+    for (char c = 'z'; c >= 'a'; --c) {
+        a.insert(std::string(1, c));
+    }
+    a.erase("m");
+    ASSERT_EQ(a.aggregate(), "abcdefghijklnopqrstuvwxyz");
+    ASSERT_EQ(a.aggregate("c", "p"), "cdefghijklnop");
+    ASSERT_EQ(a.aggregate("cc", "d"), "d");
+    BinarySearchTree<std::string, std::less<std::string>, std::allocator<std::string>, red_black_tag, concat_monoid> b(a);
+    ASSERT_EQ(b.aggregate("w", "zz"), "wxyz");
+}
+
+template <typename Tree>
+concept Splittable = requires(Tree tree) { tree.split(1); };
+
+TEST(BSTTestSuite, SplitJoin) {
+    static_assert(!Splittable<BinarySearchTree<int>>);
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, red_black_tag, order_statistics_tag> a;
+    for (int i = 0; i < 100; ++i) {
+        a.insert(i * 2);
+    }
+    auto b = a.split(51);
+    ASSERT_EQ(a.size(), 26);
+    ASSERT_EQ(b.size(), 74);
+    ASSERT_EQ(*a.rbegin(), 50);
+    ASSERT_EQ(*b.begin(), 52);
+    ASSERT_EQ(*b.nth(10), 72);
+    auto c = b.split(60);
+    ASSERT_EQ(*c.begin(), 60);
+    ASSERT_EQ(b.size(), 4);
+    a.join(std::move(b));
+    a.join(std::move(c));
+    ASSERT_TRUE(b.empty());
+    ASSERT_EQ(a.size(), 100);
+    ASSERT_EQ(a.rank(100), 50);
+    a.insert(51);
+    ASSERT_EQ(*a.nth(26), 51);
+}
+
+template <typename Balance>
+void SetAlgebra() {
+    using Tree = BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance>;
+    std::mt19937 gen(3);
+    for (int round = 0; round < 40; ++round) {
+        std::set<int> first;
+        std::set<int> second;
+        for (int i = 0; i < round * 20; ++i) {
+            first.insert(gen() % 1000);
+        }
+        for (int i = 0; i < 1000 - round * 20; ++i) {
+            second.insert(gen() % 1000);
+        }
+        std::vector<int> expected;
+        Tree a(sorted_unique_tag{}, first.begin(), first.end());
+        switch (round % 4) {
+        case 0:
+            a.set_union(Tree(sorted_unique_tag{}, second.begin(), second.end()));
+            std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            break;
+        case 1:
+            a.set_intersection(Tree(sorted_unique_tag{}, second.begin(), second.end()));
+            std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            break;
+        case 2:
+            a.set_difference(Tree(sorted_unique_tag{}, second.begin(), second.end()));
+            std::set_difference(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            break;
+        default: {
+            Tree b(sorted_unique_tag{}, second.begin(), second.end());
+            a.merge(b);
+            std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(expected));
+            std::vector<int> rest;
+            std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(rest));
+            ASSERT_EQ(Collect<inorder_tag>(b), rest);
+            ASSERT_EQ(b.size(), rest.size());
+        }
+        }
+        ASSERT_EQ(Collect<inorder_tag>(a), expected);
+        ASSERT_EQ(a.size(), expected.size());
+        for (int i = 0; i < 100; ++i) {
+            a.insert(gen() % 1000);
+            a.erase(gen() % 1000);
+        }
+    }
+}
+
+TEST(BSTTestSuite, SetAlgebraRedBlack) {
+    SetAlgebra<red_black_tag>();
+}
+
+TEST(BSTTestSuite, SetAlgebraAVL) {
+    SetAlgebra<avl_tag>();
+}
+
+TEST(BSTTestSuite, SetAlgebraUnbalanced) {
+    SetAlgebra<unbalanced_tag>();
+}
+
+TEST(BSTTestSuite, SetAlgebraDifferentPools) {
+    BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string, 8>> a = {"a", "b", "c"};
+    BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string, 8>> b = {"b", "d"};
+    a.merge(b);
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"a", "b", "c", "d"}));
+    ASSERT_EQ(Collect<inorder_tag>(b), (std::vector<std::string>{"b"}));
+    a.set_difference(std::move(b));
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"a", "c", "d"}));
+}
+
+TEST(BSTTestSuite, ParallelBuild) {
+    std::vector<int> keys(100000);
+    for (int i = 0; i < 100000; ++i) {
+        keys[i] = 3 * i;
+    }
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, red_black_tag, order_statistics_tag> a(
+        parallel_tag{}, sorted_unique_tag{}, keys.begin(), keys.end());
+    ASSERT_EQ(a.size(), keys.size());
+    ASSERT_EQ(Collect<inorder_tag>(a), keys);
+    ASSERT_EQ(*a.nth(54321), 3 * 54321);
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, avl_tag> b;
+    b.assign_sorted(parallel_tag{}, keys.begin(), keys.end());
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, avl_tag> c(sorted_unique_tag{}, keys.begin(), keys.end());
+    ASSERT_EQ(Collect<preorder_tag>(b), Collect<preorder_tag>(c));
+}
+
+TEST(BSTTestSuite, ParallelSetAlgebra) {
+    using Tree = BinarySearchTree<int>;
+    std::vector<int> evens;
+    std::vector<int> thirds;
+    for (int i = 0; i < 60000; ++i) {
+        evens.push_back(2 * i);
+        thirds.push_back(3 * i);
+    }
+    std::vector<int> expected;
+    Tree a(sorted_unique_tag{}, evens.begin(), evens.end());
+    a.set_union(parallel_tag{}, Tree(sorted_unique_tag{}, thirds.begin(), thirds.end()));
+    std::set_union(evens.begin(), evens.end(), thirds.begin(), thirds.end(), std::back_inserter(expected));
+    ASSERT_EQ(Collect<inorder_tag>(a), expected);
+    ASSERT_EQ(a.size(), expected.size());
+
+    expected.clear();
+    Tree b(sorted_unique_tag{}, evens.begin(), evens.end());
+    b.set_intersection(parallel_tag{}, Tree(sorted_unique_tag{}, thirds.begin(), thirds.end()));
+    std::set_intersection(evens.begin(), evens.end(), thirds.begin(), thirds.end(), std::back_inserter(expected));
+    ASSERT_EQ(Collect<inorder_tag>(b), expected);
+
+    expected.clear();
+    Tree c(sorted_unique_tag{}, evens.begin(), evens.end());
+    c.set_difference(parallel_tag{}, Tree(sorted_unique_tag{}, thirds.begin(), thirds.end()));
+    std::set_difference(evens.begin(), evens.end(), thirds.begin(), thirds.end(), std::back_inserter(expected));
+    ASSERT_EQ(Collect<inorder_tag>(c), expected);
+
+    Tree d(sorted_unique_tag{}, evens.begin(), evens.end());
+    Tree e(sorted_unique_tag{}, thirds.begin(), thirds.end());
+    d.merge(parallel_tag{}, e);
+    ASSERT_EQ(Collect<inorder_tag>(d), Collect<inorder_tag>(a));
+    ASSERT_EQ(Collect<inorder_tag>(e), Collect<inorder_tag>(b));
+}
+
+TEST(BSTTestSuite, ParallelTraversal) {
+    BinarySearchTree<long long> a;
+    for (long long i = 1; i <= 20000; ++i) {
+        a.insert(i);
+    }
+    std::atomic<long long> sum = 0;
+    a.for_each(parallel_tag{}, [&](long long value) { sum += value; });
+    ASSERT_EQ(sum, 20000LL * 20001 / 2);
+    ASSERT_EQ(a.reduce(parallel_tag{}, 0LL, std::plus<>()), 20000LL * 20001 / 2);
+
+    BinarySearchTree<std::string> b;
+    std::string expected;
+    for (int i = 0; i < 5000; ++i) {
+        b.insert(std::to_string(10000 + i));
+        expected += std::to_string(10000 + i);
+    }
+    ASSERT_EQ(b.reduce(parallel_tag{}, std::string(), std::plus<>()), expected);
+    BinarySearchTree<std::string> empty;
+    ASSERT_EQ(empty.reduce(parallel_tag{}, std::string("x"), std::plus<>()), "x");
+}
+
+TEST(BSTTestSuite, PoolAllocatorReuse) {
+    PoolAllocator<int, 4> alloc;
+    int* first = alloc.allocate(1);
+    int* second = alloc.allocate(1);
+    alloc.deallocate(first, 1);
+    ASSERT_EQ(alloc.allocate(1), first);
+    ASSERT_NE(alloc.allocate(1), second);
+    alloc.release();
+}
 
+TEST(BSTTestSuite, PoolAllocatorTree) {
+    BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string, 8>> a;
+    for (int i = 0; i < 100; ++i) {
+        a.insert(std::to_string(i));
+    }
+    for (int i = 0; i < 100; i += 2) {
+        a.erase(std::to_string(i));
+    }
+    ASSERT_EQ(a.size(), 50);
+    auto b = a;
+    a.clear();
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(b.size(), 50);
+    ASSERT_TRUE(b.contains("51"));
+    a.insert("x");
+    ASSERT_EQ(*a.begin(), "x");
+}
+
+TEST(BSTTestSuite, PoolAllocatorRebindSharesArena) {
+    PoolAllocator<std::string, 8> alloc;
+    PoolAllocator<double, 8> rebound(alloc);
+    ASSERT_TRUE(rebound == alloc);
+    ASSERT_TRUE((PoolAllocator<std::string, 8>(rebound) == alloc));
+    ASSERT_TRUE((PoolAllocator<std::string, 8>() != alloc));
+    double* value = rebound.allocate(1);
+    ASSERT_EQ(alloc.in_use(), 1);
+    rebound.deallocate(value, 1);
+    ASSERT_EQ(alloc.in_use(), 0);
+
+    BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string, 8>> a;
+    for (int i = 0; i < 20; ++i) {
+        a.insert(std::to_string(i));
+    }
+    auto tree_alloc = a.get_allocator();
+    ASSERT_EQ(tree_alloc.in_use(), 20);
+    a.erase("3");
+    ASSERT_EQ(tree_alloc.in_use(), 19);
+    a.clear();
+    ASSERT_EQ(tree_alloc.in_use(), 0);
+}
+
+TEST(BSTTestSuite, CopyKeepsShape) {
+    BinarySearchTree<int> a = {6, 13, 8, 9, 4, 7, 1, 2};
+    BinarySearchTree<int> b(a);
+    ASSERT_EQ(Collect<preorder_tag>(b), Collect<preorder_tag>(a));
+    ASSERT_EQ(Collect<postorder_tag>(b), Collect<postorder_tag>(a));
+    ASSERT_EQ(b.size(), a.size());
+    BinarySearchTree<int> c = {100};
+    c = a;
+    ASSERT_EQ(Collect<preorder_tag>(c), Collect<preorder_tag>(a));
+    c.erase(1);
+    ASSERT_EQ(*c.begin(), 2);
+    ASSERT_EQ(*a.begin(), 1);
+}
+
+template <typename Balance>
+void SortedBuild() {
+    for (int n = 0; n < 70; ++n) {
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; ++i) {
+            keys[i] = 2 * i;
+        }
+        BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance> a(sorted_unique_tag{}, keys.begin(), keys.end());
+        ASSERT_EQ(a.size(), n);
+        ASSERT_EQ(Collect<inorder_tag>(a), keys);
+        for (int i = 0; i < n; i += 3) {
+            a.erase(2 * i);
+            a.insert(2 * i + 1);
+        }
+        std::set<int> ref(keys.begin(), keys.end());
+        for (int i = 0; i < n; i += 3) {
+            ref.erase(2 * i);
+            ref.insert(2 * i + 1);
+        }
+        ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>(ref.begin(), ref.end()));
+    }
+}
+
+TEST(BSTTestSuite, SortedBuildRedBlack) {
+    SortedBuild<red_black_tag>();
+}
+
+TEST(BSTTestSuite, SortedBuildAVL) {
+    SortedBuild<avl_tag>();
+}
+
+TEST(BSTTestSuite, AssignSortedShape) {
+    std::vector<int> keys{1, 2, 3, 4, 5, 6, 7};
+    BinarySearchTree<int> a = {10, 20};
+    a.assign_sorted(keys.begin(), keys.end());
+    std::vector<int> ans_correct{4, 2, 1, 3, 6, 5, 7};
+    ASSERT_EQ(Collect<preorder_tag>(a), ans_correct);
+}
+
+TEST(BSTTestSuite, MoveTest) {
+    BinarySearchTree<std::string> a = {"abs", "mn", "abb", "mnk", "zrt"};
+    BinarySearchTree<std::string> b(std::move(a));
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(b.size(), 5);
+    ASSERT_EQ(*b.begin(), "abb");
+    a.insert("q");
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<std::string>{"q"});
+    a = std::move(b);
+    ASSERT_EQ(a.size(), 5);
+    ASSERT_TRUE(b.empty());
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"abb", "abs", "mn", "mnk", "zrt"}));
+}
+
+TEST(BSTTestSuite, EmplaceTest) {
+    BinarySearchTree<std::string> a;
+    std::string key = "abc";
+    ASSERT_TRUE(a.insert(std::move(key)).second);
+    ASSERT_TRUE(a.emplace(3, 'x').second);
+    ASSERT_FALSE(a.emplace("xxx").second);
+    ASSERT_EQ(*a.emplace_hint(a.begin(), "b"), "b");
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"abc", "b", "xxx"}));
+}
+
+TEST(BSTTestSuite, ExtractTest) {
+    BinarySearchTree<int> a = {6, 13, 8, 9, 4, 7};
+    BinarySearchTree<int> b = {8};
+    auto handle = a.extract(9);
+    ASSERT_FALSE(handle.empty());
+    ASSERT_EQ(handle.value(), 9);
+    ASSERT_EQ(a.size(), 5);
+    const int* address = &handle.value();
+    auto res = b.insert(std::move(handle));
+    ASSERT_TRUE(res.inserted);
+    ASSERT_EQ(&*res.position, address);
+    ASSERT_TRUE(a.extract(100).empty());
+    auto dup = b.insert(a.extract(a.find(8)));
+    ASSERT_FALSE(dup.inserted);
+    ASSERT_EQ(dup.node.value(), 8);
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<int>{4, 6, 7, 13}));
+    ASSERT_EQ(Collect<inorder_tag>(b), (std::vector<int>{8, 9}));
+}
+
+TEST(BSTTestSuite, PoolAllocatorExtract) {
+    using Tree = BinarySearchTree<std::string, std::less<std::string>, PoolAllocator<std::string, 4>>;
+    Tree a = {"a", "b", "c"};
+    Tree b;
+    auto handle = a.extract("b");
+    a.clear();
+    ASSERT_EQ(handle.value(), "b");
+    auto res = b.insert(std::move(handle));
+    ASSERT_TRUE(res.inserted);
+    ASSERT_EQ(*b.begin(), "b");
+}
+
+template <typename T>
+struct CountedAllocator {
+    using value_type = T;
+
+    CountedAllocator() = default;
+
+    template <typename U>
+    CountedAllocator(const CountedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        ++allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) { std::allocator<T>().deallocate(ptr, n); }
+
+    bool operator==(const CountedAllocator&) const { return true; }
+
+    static inline int allocations = 0;
+};
+
+TEST(BSTTestSuite, DuplicateInsertDoesNotAllocate) {
+    BinarySearchTree<int, std::less<int>, CountedAllocator<int>> a = {6, 13, 8, 9, 4, 7};
+    int before = CountedAllocator<typename decltype(a)::node_type>::allocations;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_FALSE(a.insert(8).second);
+        ASSERT_FALSE(a.emplace(13).second);
+        ASSERT_FALSE(a.try_emplace(4).second);
+    }
+    ASSERT_EQ(CountedAllocator<typename decltype(a)::node_type>::allocations, before);
+    ASSERT_TRUE(a.insert(5).second);
+    ASSERT_EQ(CountedAllocator<typename decltype(a)::node_type>::allocations, before + 1);
+}
+
+TEST(BSTTestSuite, ClearTest) {
+    BinarySearchTree<std::string> a;
+    for (int i = 0; i < 1000; ++i) {
+        a.insert(std::to_string(i * 7919 % 1000));
+    }
+    a.clear();
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(a.size(), 0);
+    ASSERT_TRUE(a.begin<postorder_tag>() == a.end<postorder_tag>());
+    a.clear();
+    a = {"b", "a", "c"};
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"a", "b", "c"}));
+}
+
+TEST(BSTTestSuite, BackgroundClear) {
+    BackgroundReclaimer reclaimer;
+    BinarySearchTree<std::string> a;
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            a.insert(std::string(32, 'a') + std::to_string(i));
+        }
+        a.clear(reclaimer);
+        ASSERT_TRUE(a.empty());
+        ASSERT_TRUE(a.begin() == a.end());
+    }
+    a.insert("x");
+    reclaimer.drain();
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"x"}));
+}
+
+TEST(BSTTestSuite, TryEmplaceTest) {
+    BinarySearchTree<std::string> a = {"abc"};
+    ASSERT_FALSE(a.try_emplace(std::string("abc")).second);
+    auto res = a.try_emplace("abd");
+    ASSERT_TRUE(res.second);
+    ASSERT_EQ(*res.first, "abd");
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<std::string>{"abc", "abd"}));
+}
+
+template <typename Balance>
+void HintedInsert() {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance> a;
+    auto last = a.end();
+    for (int i = 0; i < 1000; i += 2) {
+        last = a.insert(last, i);
+        ASSERT_EQ(*last, i);
+    }
+    for (int i = 1999; i >= 1000; i -= 2) {
+        a.insert(a.end(), i);
+    }
+    for (int i = 1; i < 1000; i += 2) {
+        a.emplace_hint(a.find(i - 1), i);
+    }
+    ASSERT_EQ(*a.insert(a.begin(), 10), 10);
+    std::set<int> ref;
+    for (int i = 0; i < 1000; ++i) {
+        ref.insert(i);
+    }
+    for (int i = 1001; i < 2000; i += 2) {
+        ref.insert(i);
+    }
+    std::mt19937 gen(8);
+    for (int i = 0; i < 3000; ++i) {
+        int key = gen() % 4000;
+        auto hint = a.lower_bound(static_cast<int>(gen() % 4000));
+        ASSERT_EQ(*a.insert(hint, key), key);
+        ref.insert(key);
+    }
+    ASSERT_EQ(a.size(), ref.size());
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>(ref.begin(), ref.end()));
+    for (int i = 0; i < 2000; ++i) {
+        int key = gen() % 4100;
+        auto finger = a.lower_bound(static_cast<int>(gen() % 4100));
+        auto it = a.find_from(finger, key);
+        ASSERT_EQ(it == a.end(), ref.count(key) == 0);
+        if (it != a.end()) {
+            ASSERT_EQ(*it, key);
+        }
+    }
+}
+
+TEST(BSTTestSuite, HintedInsertRedBlack) {
+    HintedInsert<red_black_tag>();
+}
+
+TEST(BSTTestSuite, HintedInsertAVL) {
+    HintedInsert<avl_tag>();
+}
+
+TEST(BSTTestSuite, HintedInsertUnbalanced) {
+    HintedInsert<unbalanced_tag>();
+}
+
+template <typename Balance>
+void Threaded() {
+    using Tree = BinarySearchTree<int, std::less<int>, std::allocator<int>, Balance, order_statistics_tag, threaded_tag>;
+    auto check = [](const Tree& tree, const std::set<int>& ref) {
+        ASSERT_EQ(Collect<inorder_tag>(tree), std::vector<int>(ref.begin(), ref.end()));
+        std::vector<int> backward;
+        for (auto it = tree.rbegin(); it != tree.rend(); ++it) {
+            backward.push_back(*it);
+        }
+        ASSERT_EQ(backward, std::vector<int>(ref.rbegin(), ref.rend()));
+    };
+    Tree a;
+    std::set<int> ref;
+    std::mt19937 gen(11);
+    for (int i = 0; i < 4000; ++i) {
+        int key = gen() % 1000;
+        if (gen() % 3 == 0) {
+            ASSERT_EQ(a.erase(key), ref.erase(key));
+        } else {
+            ASSERT_EQ(a.insert(key).second, ref.insert(key).second);
+        }
+    }
+    check(a, ref);
+    int smallest = *ref.begin();
+    auto node = a.extract(smallest);
+    ref.erase(smallest);
+    check(a, ref);
+    a.insert(std::move(node));
+    ref.insert(smallest);
+    check(a, ref);
+
+    Tree b = a.split(500);
+    std::set<int> ref_b(ref.lower_bound(500), ref.end());
+    ref.erase(ref.lower_bound(500), ref.end());
+    check(a, ref);
+    check(b, ref_b);
+    Tree c = a.split(-1);
+    check(a, {});
+    check(c, ref);
+    c.join(std::move(b));
+    ref.insert(ref_b.begin(), ref_b.end());
+    check(c, ref);
+    check(b, {});
+
+    Tree copy = c;
+    check(copy, ref);
+    Tree moved = std::move(copy);
+    check(moved, ref);
+    check(copy, {});
+
+    std::set<int> other;
+    for (int i = 0; i < 600; ++i) {
+        other.insert(gen() % 2000);
+    }
+    moved.set_union(Tree(sorted_unique_tag{}, other.begin(), other.end()));
+    ref.insert(other.begin(), other.end());
+    check(moved, ref);
+    moved.insert(-5);
+    moved.erase(*ref.rbegin());
+    ref.insert(-5);
+    ref.erase(*ref.rbegin());
+    check(moved, ref);
+}
+
+TEST(BSTTestSuite, ThreadedRedBlack) {
+    Threaded<red_black_tag>();
+}
+
+TEST(BSTTestSuite, ThreadedAVL) {
+    Threaded<avl_tag>();
+}
+
+static_assert(std::bidirectional_iterator<BinarySearchTree<int>::iterator<inorder_tag>>);
+static_assert(std::bidirectional_iterator<BinarySearchTree<int>::iterator<preorder_tag>>);
+static_assert(std::bidirectional_iterator<BinarySearchTree<int>::iterator<postorder_tag>>);
+static_assert(std::bidirectional_iterator<BinarySearchMap<int, std::string>::iterator<>>);
+static_assert(std::ranges::bidirectional_range<BinarySearchTree<int>>);
+static_assert(std::ranges::view<decltype(std::declval<BinarySearchTree<int>>().view<preorder_tag>())>);
+
+TEST(BSTTestSuite, BidirectionalIterators) {
+    BinarySearchTree<int> a = {5, 3, 8, 1, 4, 7, 9};
+    auto it = a.begin();
+    ASSERT_EQ(*it++, 1);
+    ASSERT_EQ(*it, 3);
+    ASSERT_EQ(*it--, 3);
+    ASSERT_EQ(*it, 1);
+    ASSERT_EQ(std::distance(a.begin(), a.end()), 7);
+    ASSERT_EQ(*std::next(a.begin(), 3), 5);
+    ASSERT_EQ(*std::prev(a.end(), 2), 8);
+    ASSERT_EQ(std::ranges::distance(a.view<postorder_tag>()), 7);
+    std::vector<int> ref = {1, 3, 4, 5, 7, 8, 9};
+    ASSERT_TRUE(std::equal(a.begin(), a.end(), ref.begin(), ref.end()));
+    ASSERT_TRUE(std::ranges::equal(a | std::views::reverse, ref | std::views::reverse));
+    ASSERT_EQ(*std::ranges::find(a, 7), 7);
+    ASSERT_EQ(*std::ranges::max_element(a.view<preorder_tag>()), 9);
+    std::vector<int> pre;
+    for (int x : a.view<preorder_tag>()) {
+        pre.push_back(x);
+    }
+    ASSERT_EQ(pre, Collect<preorder_tag>(a));
+}
+
+TEST(BSTTestSuite, RangeViews) {
+    BinarySearchTree<int> a;
+    for (int i = 0; i < 100; ++i) {
+        a.insert(i * 2);
+    }
+    std::vector<int> odd_tens;
+    for (int x : a.range(15, 61) | std::views::transform([](int x) { return x / 10; }) |
+                     std::views::filter([](int x) { return x % 2 == 1; })) {
+        odd_tens.push_back(x);
+    }
+    ASSERT_EQ(odd_tens, (std::vector<int>{1, 1, 3, 3, 3, 3, 3, 5, 5, 5, 5, 5}));
+    ASSERT_EQ(std::ranges::distance(a.range(10, 20)), 6);
+    ASSERT_TRUE(a.range(20, 10).empty());
+    ASSERT_TRUE(a.range(201, 300).empty());
+    ASSERT_EQ(a.range(-5, 0).front(), 0);
+    ASSERT_EQ(*a.range(190, 1000).rbegin(), 198);
+
+    BinarySearchMap<std::string, int> m = {{"apple", 1}, {"banana", 2}, {"cherry", 3}, {"date", 4}};
+    int sum = 0;
+    for (auto& [key, value] : m.range(std::string("b"), std::string("d"))) {
+        sum += value;
+    }
+    ASSERT_EQ(sum, 5);
+}
+
+template <typename Augment>
+void RangeScan() {
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, red_black_tag, Augment> a;
+    std::set<int> ref;
+    std::mt19937 gen(21);
+    for (int i = 0; i < 2000; ++i) {
+        int key = gen() % 5000;
+        a.insert(key);
+        ref.insert(key);
+    }
+    for (int i = 0; i < 300; ++i) {
+        int lo = static_cast<int>(gen() % 5200) - 100;
+        int hi = lo + static_cast<int>(gen() % 400) - 50;
+        std::vector<int> expected;
+        for (auto it = ref.lower_bound(lo); it != ref.end() && *it <= hi; ++it) {
+            expected.push_back(*it);
+        }
+        auto view = a.range(lo, hi);
+        static_assert(std::ranges::view<decltype(view)> && std::ranges::bidirectional_range<decltype(view)>);
+        std::vector<int> forward(view.begin(), std::ranges::next(view.begin(), view.end()));
+        ASSERT_EQ(forward, expected);
+        std::vector<int> backward(view.rbegin(), view.rend());
+        ASSERT_EQ(backward, std::vector<int>(expected.rbegin(), expected.rend()));
+        ASSERT_EQ(view.empty(), expected.empty());
+        if constexpr (std::ranges::sized_range<decltype(view)>) {
+            ASSERT_EQ(view.size(), expected.size());
+        }
+        std::vector<int> page;
+        for (int x : a.keys_from(lo) | std::views::take(10)) {
+            page.push_back(x);
+        }
+        std::vector<int> ref_page;
+        for (auto it = ref.lower_bound(lo); it != ref.end() && ref_page.size() < 10; ++it) {
+            ref_page.push_back(*it);
+        }
+        ASSERT_EQ(page, ref_page);
+    }
+}
+
+TEST(BSTTestSuite, RangeScan) {
+    RangeScan<no_augment_tag>();
+}
+
+TEST(BSTTestSuite, RangeScanSized) {
+    static_assert(std::ranges::sized_range<decltype(BinarySearchTree<int, std::less<int>, std::allocator<int>, red_black_tag,
+                                                                     order_statistics_tag>().range(0, 1))>);
+    RangeScan<order_statistics_tag>();
+}
+
+TEST(BSTTestSuite, BatchLookup) {
+    BinarySearchTree<int> a;
+    std::set<int> ref;
+    std::mt19937 gen(12);
+    for (int i = 0; i < 5000; ++i) {
+        int key = gen() % 20000;
+        a.insert(key);
+        ref.insert(key);
+    }
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; ++i) {
+        keys.push_back(static_cast<int>(gen() % 20100) - 50);
+    }
+    std::vector<int> sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    for (const std::vector<int>& batch : {keys, sorted}) {
+        std::vector<BinarySearchTree<int>::iterator<>> found(batch.size(), a.end());
+        std::vector<BinarySearchTree<int>::iterator<>> lower(batch.size(), a.end());
+        a.find_batch(batch, found);
+        a.lower_bound_batch(batch, lower);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            ASSERT_EQ(found[i] == a.end(), ref.count(batch[i]) == 0);
+            ASSERT_EQ(found[i], a.find(batch[i]));
+            ASSERT_EQ(lower[i], a.lower_bound(batch[i]));
+        }
+    }
+    BinarySearchTree<int> empty;
+    std::vector<BinarySearchTree<int>::iterator<>> out(keys.size(), empty.end());
+    empty.find_batch(keys, out);
+    ASSERT_EQ(out.front(), empty.end());
+}
+
+TEST(BSTTestSuite, TransparentLookup) {
+    BinarySearchTree<std::string, std::less<>> a = {"abs", "mn", "abb", "mnk", "zrt"};
+    std::string_view key = "mnk";
+    ASSERT_EQ(*a.find(key), "mnk");
+    ASSERT_TRUE(a.contains(std::string_view("abb")));
+    ASSERT_FALSE(a.contains("ki"));
+    ASSERT_EQ(a.count(std::string_view("zrt")), 1);
+    ASSERT_EQ(*a.lower_bound(std::string_view("b")), "mn");
+    ASSERT_EQ(*a.upper_bound(std::string_view("mn")), "mnk");
+    auto range = a.equal_range(std::string_view("abs"));
+    ASSERT_EQ(*range.first, "abs");
+    ASSERT_EQ(*range.second, "mn");
+    ASSERT_TRUE(a.try_emplace(std::string_view("q")).second);
+    ASSERT_EQ(*a.find<preorder_tag>(std::string_view("q")), "q");
+}
+
+TEST(BSTTestSuite, GreaterCompare) {
+    BinarySearchTree<int, std::greater<int>> a = {6, 13, 8, 9, 4, 7};
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<int>{13, 9, 8, 7, 6, 4}));
+    ASSERT_EQ(*a.find(8), 8);
+    ASSERT_TRUE(a.find(5) == a.end());
+    ASSERT_EQ(*a.lower_bound(10), 9);
+    ASSERT_EQ(*a.lower_bound(9), 9);
+    ASSERT_EQ(*a.upper_bound(9), 8);
+    ASSERT_TRUE(a.upper_bound(4) == a.end());
+    ASSERT_FALSE(a.insert(13).second);
+    ASSERT_EQ(a.erase(7), 1);
+    ASSERT_EQ(Collect<inorder_tag>(a), (std::vector<int>{13, 9, 8, 6, 4}));
+}
+
+struct CaseInsensitiveLess {
+    bool operator()(const std::string& lhs, const std::string& rhs) const {
+        return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), 
+            [](char x, char y) { return std::tolower(x) < std::tolower(y); });
+    }
+};
+
+TEST(BSTTestSuite, EquivalentNotEqualKeys) {
+    BinarySearchTree<std::string, CaseInsensitiveLess> a = {"Abc", "xyz"};
+    ASSERT_EQ(*a.find("ABC"), "Abc");
+    ASSERT_FALSE(a.insert("XYZ").second);
+    ASSERT_EQ(*a.lower_bound("aBC"), "Abc");
+    ASSERT_EQ(*a.upper_bound("aBC"), "xyz");
+    ASSERT_EQ(a.size(), 2);
+}
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> CollectBackward(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    auto it = tree.template end<OrderType>();
+    while (it != tree.template begin<OrderType>()) {
+        --it;
+        ans.push_back(*it);
+    }
+    std::reverse(ans.begin(), ans.end());
+    return ans;
+}
+
+static_assert(std::bidirectional_iterator<FrozenTree<int>::iterator<inorder_tag>>);
+static_assert(std::bidirectional_iterator<FrozenTree<int>::iterator<preorder_tag>>);
+static_assert(std::bidirectional_iterator<FrozenTree<int>::iterator<postorder_tag>>);
+static_assert(std::ranges::bidirectional_range<FrozenTree<int>>);
+
+TEST(FrozenTreeTestSuite, ShapeAndOrder) {
+    BinarySearchTree<int> a = {1, 2, 3, 4, 5, 6};
+    auto frozen = a.freeze();
+    ASSERT_EQ(frozen.size(), 6);
+    ASSERT_EQ(Collect<inorder_tag>(frozen), (std::vector<int>{1, 2, 3, 4, 5, 6}));
+    ASSERT_EQ(Collect<preorder_tag>(frozen), (std::vector<int>{4, 2, 1, 3, 6, 5}));
+    ASSERT_EQ(Collect<postorder_tag>(frozen), (std::vector<int>{1, 3, 2, 5, 6, 4}));
+    ASSERT_EQ(CollectBackward<inorder_tag>(frozen), Collect<inorder_tag>(frozen));
+    ASSERT_EQ(CollectBackward<preorder_tag>(frozen), Collect<preorder_tag>(frozen));
+    ASSERT_EQ(CollectBackward<postorder_tag>(frozen), Collect<postorder_tag>(frozen));
+}
+
+TEST(FrozenTreeTestSuite, Lookup) {
+    for (int n = 0; n < 100; ++n) {
+        BinarySearchTree<int> a;
+        for (int i = 0; i < n; ++i) {
+            a.insert(3 * i);
+        }
+        auto frozen = a.freeze();
+        ASSERT_EQ(Collect<inorder_tag>(frozen), Collect<inorder_tag>(a));
+        ASSERT_EQ(CollectBackward<preorder_tag>(frozen), Collect<preorder_tag>(frozen));
+        ASSERT_EQ(CollectBackward<postorder_tag>(frozen), Collect<postorder_tag>(frozen));
+        auto keys = Collect<inorder_tag>(a);
+        std::set<int> ref(keys.begin(), keys.end());
+        for (int key = -2; key < 3 * n + 2; ++key) {
+            auto lb = frozen.lower_bound(key);
+            auto ub = frozen.upper_bound(key);
+            auto ref_lb = ref.lower_bound(key);
+            auto ref_ub = ref.upper_bound(key);
+            ASSERT_EQ(lb == frozen.end(), ref_lb == ref.end());
+            ASSERT_EQ(ub == frozen.end(), ref_ub == ref.end());
+            if (ref_lb != ref.end()) {
+                ASSERT_EQ(*lb, *ref_lb);
+            }
+            if (ref_ub != ref.end()) {
+                ASSERT_EQ(*ub, *ref_ub);
+            }
+            ASSERT_EQ(frozen.contains(key), a.contains(key));
+        }
+    }
+}
+
+TEST(FrozenTreeTestSuite, Strings) {
+    BinarySearchTree<std::string, std::less<>> a = {"abs", "mn", "abb", "mnk", "zrt"};
+    auto frozen = a.freeze();
+    auto copy = frozen;
+    ASSERT_EQ(*copy.find(std::string_view("mnk")), "mnk");
+    ASSERT_TRUE(copy.find("x") == copy.end());
+    auto range = copy.equal_range("mn");
+    ASSERT_EQ(*range.first, "mn");
+    ASSERT_EQ(*range.second, "mnk");
+}
+
+TEST(MapTestSuite, MapBasics) {
+    BinarySearchMap<std::string, int> a;
+    a["b"] = 2;
+    a["a"] = 1;
+    ++a["b"];
+    ASSERT_EQ(a.size(), 2);
+    ASSERT_EQ(a.find("b")->second, 3);
+    ASSERT_FALSE(a.try_emplace("a", 10).second);
+    ASSERT_EQ(a["a"], 1);
+    auto res = a.insert_or_assign("a", 10);
+    ASSERT_FALSE(res.second);
+    ASSERT_EQ(res.first->second, 10);
+    ASSERT_TRUE(a.insert_or_assign("c", 5).second);
+    ASSERT_TRUE(a.insert({"d", 7}).second);
+    std::vector<std::string> keys;
+    for (auto it = a.begin(); it != a.end(); ++it) {
+        it->second *= 2;
+        keys.push_back(it->first);
+    }
+    ASSERT_EQ(keys, std::vector<std::string>({"a", "b", "c", "d"}));
+    ASSERT_EQ(a["d"], 14);
+    ASSERT_EQ(a.erase("c"), 1);
+    ASSERT_EQ(a.erase("c"), 0);
+    ASSERT_FALSE(a.contains("c"));
+    ASSERT_EQ(a.lower_bound("bb")->first, "d");
+}
+
+TEST(MapTestSuite, MapRandom) {
+    BinarySearchMap<int, int, std::less<int>, std::allocator<std::pair<const int, int>>, avl_tag> a;
+    std::map<int, int> ref;
+    std::mt19937 gen(21);
+    for (int i = 0; i < 5000; ++i) {
+        int key = gen() % 300;
+        int op = gen() % 3;
+        if (op == 0) {
+            ASSERT_EQ(a.erase(key), ref.erase(key));
+        } else if (op == 1) {
+            a[key] += i;
+            ref[key] += i;
+        } else {
+            ASSERT_EQ(a.try_emplace(key, i).second, ref.try_emplace(key, i).second);
+        }
+    }
+    ASSERT_EQ(a.size(), ref.size());
+    auto it = a.begin();
+    for (const auto& [key, value] : ref) {
+        ASSERT_EQ(it->first, key);
+        ASSERT_EQ(it->second, value);
+        ++it;
+    }
+    auto copy = a;
+    ASSERT_TRUE(copy == a);
+}
+
+TEST(MapTestSuite, Multiset) {
+    BinarySearchMultiset<int> a = {3, 1, 3, 2, 3};
+    ASSERT_EQ(a.size(), 5);
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>({1, 2, 3, 3, 3}));
+    ASSERT_EQ(a.count(3), 3);
+    ASSERT_EQ(a.count(4), 0);
+    a.insert(2);
+    ASSERT_EQ(a.erase(3), 3);
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>({1, 2, 2}));
+    static_assert(std::is_same_v<BinarySearchMultiset<int, std::greater<int>>::key_compare, std::greater<int>>);
+    ASSERT_TRUE((BinarySearchMultiset<int, std::greater<int>>().key_comp()(2, 1)));
+
+    BinarySearchMultiset<int, std::less<int>, std::allocator<int>, avl_tag, order_statistics_tag> b;
+    std::multiset<int> ref;
+    std::mt19937 gen(4);
+    for (int i = 0; i < 5000; ++i) {
+        int key = gen() % 100;
+        if (gen() % 4 == 0) {
+            ASSERT_EQ(b.erase(key), ref.erase(key));
+        } else {
+            b.insert(key);
+            ref.insert(key);
+        }
+        ASSERT_EQ(b.count(key), ref.count(key));
+    }
+    ASSERT_EQ(Collect<inorder_tag>(b), std::vector<int>(ref.begin(), ref.end()));
+}
+
+TEST(MapTestSuite, Multimap) {
+    BinarySearchMultimap<std::string, int> a;
+    a.emplace("x", 1);
+    a.emplace("y", 2);
+    a.emplace("x", 3);
+    a.insert({"x", 5});
+    ASSERT_EQ(a.count("x"), 3);
+    std::vector<int> values;
+    for (auto range = a.equal_range("x"); range.first != range.second; ++range.first) {
+        values.push_back(range.first->second);
+    }
+    ASSERT_EQ(values, std::vector<int>({1, 3, 5}));
+    ASSERT_EQ(a.erase("x"), 3);
+    ASSERT_EQ(a.size(), 1);
+    ASSERT_EQ(a.begin()->second, 2);
+
+    using Reversed = BinarySearchMultimap<int, std::string, std::greater<int>>;
+    static_assert(std::is_same_v<Reversed::mapped_type, std::string>);
+    static_assert(std::is_same_v<Reversed::key_compare, std::greater<int>>);
+    Reversed b = {{1, "a"}, {2, "b"}, {1, "c"}};
+    ASSERT_TRUE(b.key_comp()(2, 1));
+    ASSERT_EQ(b.begin()->second, "b");
+    ASSERT_EQ(b.count(1), 2);
+}
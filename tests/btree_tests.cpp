@@ -0,0 +1,250 @@
+#include <lib/BTree.cpp>
+#include <gtest/gtest.h>
+#include <vector>
+#include <set>
+#include <random>
+#include <string>
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> Collect(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    for (auto it = tree.template begin<OrderType>(); it != tree.template end<OrderType>(); ++it) {
+        ans.push_back(*it);
+    }
+    return ans;
+}
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> CollectBackward(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    auto it = tree.template end<OrderType>();
+    while (it != tree.template begin<OrderType>()) {
+        --it;
+        ans.push_back(*it);
+    }
+    std::reverse(ans.begin(), ans.end());
+    return ans;
+}
+
+TEST(BTreeTestSuite, InOrderDefault) {
+    BTree<int> a = {6, 13, 8, 9, 4, 7};
+    std::vector<int> ans_correct{4, 6, 7, 8, 9, 13};
+    ASSERT_EQ(Collect<inorder_tag>(a), ans_correct);
+    ASSERT_EQ(a.size(), 6);
+}
+
+TEST(BTreeTestSuite, ReverseTest) {
+    BTree<int> a = {6, 13, 8, 9, 4, 7};
+    std::vector<int> ans;
+    for (auto it = a.rbegin(); it != a.rend(); ++it) {
+        ans.push_back(*it);
+    }
+    std::vector<int> ans_correct{13, 9, 8, 7, 6, 4};
+    ASSERT_EQ(ans, ans_correct);
+}
+
+TEST(BTreeTestSuite, PreAndPostOrder) {
+    BTree<int, std::less<int>, std::allocator<int>, 8> a = {1, 2, 3, 4, 5, 6, 7};
+    std::vector<int> pre_correct{2, 4, 1, 3, 5, 6, 7};
+    std::vector<int> post_correct{1, 3, 5, 6, 7, 2, 4};
+    ASSERT_EQ(Collect<preorder_tag>(a), pre_correct);
+    ASSERT_EQ(Collect<postorder_tag>(a), post_correct);
+    ASSERT_EQ(CollectBackward<preorder_tag>(a), pre_correct);
+    ASSERT_EQ(CollectBackward<postorder_tag>(a), post_correct);
+}
+
+TEST(BTreeTestSuite, LookupTest) {
+    BTree<std::string> a = {"abs", "mn", "abb", "mnk", "zrt"};
+    ASSERT_EQ(*a.find("mnk"), "mnk");
+    ASSERT_TRUE(a.find("ki") == a.end());
+    ASSERT_TRUE(a.contains("zrt"));
+    ASSERT_EQ(*a.lower_bound("b"), "mn");
+    ASSERT_EQ(*a.upper_bound("mn"), "mnk");
+    ASSERT_TRUE(a.upper_bound("zrt") == a.end());
+    ASSERT_FALSE(a.insert("abb").second);
+}
+
+TEST(BTreeTestSuite, CopyAndMove) {
+    BTree<int, std::less<int>, std::allocator<int>, 16> a;
+    for (int i = 0; i < 200; ++i) {
+        a.insert(i * 7 % 200);
+    }
+    BTree<int, std::less<int>, std::allocator<int>, 16> b(a);
+    ASSERT_TRUE(a == b);
+    ASSERT_EQ(Collect<preorder_tag>(a), Collect<preorder_tag>(b));
+    auto c = std::move(b);
+    ASSERT_TRUE(b.empty());
+    ASSERT_TRUE(a == c);
+    b = c;
+    ASSERT_EQ(b.size(), 200);
+}
+
+template <size_t NodeBytes>
+void RandomBTree() {
+    BTree<int, std::less<int>, std::allocator<int>, NodeBytes> a;
+    std::set<int> ref;
+    std::mt19937 gen(7);
+    for (int i = 0; i < 20000; ++i) {
+        int key = gen() % 2000;
+        if (gen() % 3 == 0) {
+            auto it = a.find(key);
+            auto ref_it = ref.find(key);
+            ASSERT_EQ(it == a.end(), ref_it == ref.end());
+            if (ref_it != ref.end()) {
+                auto next = a.erase(it);
+                auto ref_next = ref.erase(ref_it);
+                ASSERT_EQ(next == a.end(), ref_next == ref.end());
+                if (ref_next != ref.end()) {
+                    ASSERT_EQ(*next, *ref_next);
+                }
+            }
+        } else {
+            ASSERT_EQ(a.insert(key).second, ref.insert(key).second);
+        }
+        ASSERT_EQ(a.size(), ref.size());
+    }
+    std::vector<int> expected(ref.begin(), ref.end());
+    ASSERT_EQ(Collect<inorder_tag>(a), expected);
+    ASSERT_EQ(CollectBackward<inorder_tag>(a), expected);
+    ASSERT_EQ(CollectBackward<preorder_tag>(a), Collect<preorder_tag>(a));
+    ASSERT_EQ(CollectBackward<postorder_tag>(a), Collect<postorder_tag>(a));
+    auto pre = Collect<preorder_tag>(a);
+    std::sort(pre.begin(), pre.end());
+    ASSERT_EQ(pre, expected);
+    for (int key = -1; key < 2001; key += 13) {
+        auto lb = a.lower_bound(key);
+        auto ref_lb = ref.lower_bound(key);
+        ASSERT_EQ(lb == a.end(), ref_lb == ref.end());
+        if (ref_lb != ref.end()) {
+            ASSERT_EQ(*lb, *ref_lb);
+        }
+    }
+    a.erase(++a.begin(), --a.end());
+    ASSERT_EQ(a.size(), 2);
+    a.clear();
+    ASSERT_TRUE(a.empty());
+    ASSERT_TRUE(a.begin() == a.end());
+}
+
+TEST(BTreeTestSuite, RandomMinimalNodes) {
+    RandomBTree<8>();
+}
+
+TEST(BTreeTestSuite, RandomSmallNodes) {
+    RandomBTree<24>();
+}
+
+TEST(BTreeTestSuite, RandomDefaultNodes) {
+    RandomBTree<256>();
+}
+
+static_assert(std::bidirectional_iterator<BTree<int>::iterator<inorder_tag>>);
+static_assert(std::bidirectional_iterator<BTree<int>::iterator<preorder_tag>>);
+static_assert(std::bidirectional_iterator<BTree<int>::iterator<postorder_tag>>);
+
+template <size_t NodeBytes>
+void HintedBTree() {
+    BTree<int, std::less<int>, std::allocator<int>, NodeBytes> a;
+    std::set<int> ref;
+    for (int i = 0; i < 3000; ++i) {
+        ASSERT_EQ(*a.emplace_hint(a.end(), 2 * i), 2 * i);
+        ref.insert(2 * i);
+        ASSERT_EQ(*--a.end(), 2 * i);
+    }
+    std::mt19937 gen(4);
+    for (int i = 0; i < 3000; ++i) {
+        int key = gen() % 7000 - 500;
+        auto hint = (gen() % 2 == 0) ? a.upper_bound(key) : a.lower_bound(static_cast<int>(gen() % 7000));
+        ASSERT_EQ(*a.emplace_hint(hint, key), key);
+        ref.insert(key);
+        ASSERT_EQ(a.size(), ref.size());
+    }
+    std::vector<int> expected(ref.begin(), ref.end());
+    ASSERT_EQ(Collect<inorder_tag>(a), expected);
+    ASSERT_EQ(CollectBackward<inorder_tag>(a), expected);
+    ASSERT_EQ(CollectBackward<preorder_tag>(a), Collect<preorder_tag>(a));
+    ASSERT_EQ(std::distance(a.begin(), a.end()), static_cast<std::ptrdiff_t>(ref.size()));
+    auto it = a.begin();
+    ASSERT_EQ(*it++, expected[0]);
+    ASSERT_EQ(*it, expected[1]);
+}
+
+TEST(BTreeTestSuite, HintedInsertMinimalNodes) {
+    HintedBTree<8>();
+}
+
+TEST(BTreeTestSuite, HintedInsertDefaultNodes) {
+    HintedBTree<256>();
+}
+
+TEST(BTreeTestSuite, EraseAllInOrder) {
+    BTree<std::string, std::less<std::string>, std::allocator<std::string>, 96> a;
+    for (int i = 0; i < 500; ++i) {
+        a.insert(std::to_string(i));
+    }
+    auto it = a.begin();
+    size_t erased = 0;
+    while (it != a.end()) {
+        it = a.erase(it);
+        ++erased;
+    }
+    ASSERT_EQ(erased, 500);
+    ASSERT_TRUE(a.empty());
+}
+
+template <typename T>
+void SimdMatchesScalar() {
+    std::mt19937_64 gen(11);
+    for (size_t n = 0; n < 40; ++n) {
+        std::vector<T> keys(n);
+        for (auto& key : keys) {
+            key = static_cast<T>(gen());
+        }
+        std::sort(keys.begin(), keys.end());
+        std::vector<T> probes(keys.begin(), keys.end());
+        probes.push_back(std::numeric_limits<T>::lowest());
+        probes.push_back(std::numeric_limits<T>::max());
+        probes.push_back(T(0));
+        probes.push_back(static_cast<T>(gen()));
+        for (T probe : probes) {
+            ASSERT_EQ((simd_search::count<false>(keys.data(), n, probe)), 
+                      (size_t)(std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin()));
+            ASSERT_EQ((simd_search::count<true>(keys.data(), n, probe)), 
+                      (size_t)(std::upper_bound(keys.begin(), keys.end(), probe) - keys.begin()));
+        }
+    }
+}
+
+TEST(BTreeTestSuite, SimdSearch) {
+    SimdMatchesScalar<int32_t>();
+    SimdMatchesScalar<uint32_t>();
+    SimdMatchesScalar<int64_t>();
+    SimdMatchesScalar<uint64_t>();
+    SimdMatchesScalar<float>();
+    SimdMatchesScalar<double>();
+}
+
+TEST(BTreeTestSuite, UnsignedLowerBound) {
+    BTree<uint64_t> a;
+    std::set<uint64_t> ref;
+    std::mt19937_64 gen(5);
+    for (int i = 0; i < 5000; ++i) {
+        uint64_t key = gen();
+        a.insert(key);
+        ref.insert(key);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t key = gen();
+        auto lb = a.lower_bound(key);
+        auto ref_lb = ref.lower_bound(key);
+        ASSERT_EQ(lb == a.end(), ref_lb == ref.end());
+        if (ref_lb != ref.end()) {
+            ASSERT_EQ(*lb, *ref_lb);
+            auto ref_ub = std::next(ref_lb);
+            ASSERT_EQ(a.upper_bound(*ref_lb) == a.end(), ref_ub == ref.end());
+            if (ref_ub != ref.end()) {
+                ASSERT_EQ(*a.upper_bound(*ref_lb), *ref_ub);
+            }
+        }
+    }
+}
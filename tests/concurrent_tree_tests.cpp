@@ -0,0 +1,221 @@
+#include <lib/ConcurrentTree.cpp>
+#include <gtest/gtest.h>
+#include <vector>
+#include <set>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <string>
+
+template <typename Tree>
+std::vector<typename Tree::value_type> Collect(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+        ans.push_back(*it);
+    }
+    return ans;
+}
+
+template <typename Tree>
+concept HasOrderedBegin = requires(const Tree& tree) { tree.template begin<preorder_tag>(); };
+
+static_assert(std::bidirectional_iterator<ConcurrentTree<int>::iterator>);
+static_assert(std::is_same_v<ConcurrentTree<int>::iterator, ConcurrentTree<int>::const_iterator>);
+static_assert(std::ranges::bidirectional_range<ConcurrentTree<int>>);
+static_assert(!HasOrderedBegin<ConcurrentTree<int>>);
+
+TEST(ConcurrentTreeTestSuite, SingleThread) {
+    ConcurrentTree<int> a;
+    std::set<int> ref;
+    std::mt19937 gen(5);
+    for (int i = 0; i < 20000; ++i) {
+        int key = gen() % 500;
+        if (gen() % 3 == 0) {
+            ASSERT_EQ(a.erase(key), ref.erase(key));
+        } else {
+            ASSERT_EQ(a.insert(key).second, ref.insert(key).second);
+        }
+        ASSERT_EQ(a.size(), ref.size());
+    }
+    ASSERT_EQ(Collect(a), std::vector<int>(ref.begin(), ref.end()));
+    for (int key = -1; key <= 500; ++key) {
+        ASSERT_EQ(a.contains(key), ref.count(key) == 1);
+        auto lb = a.lower_bound(key);
+        auto ref_lb = ref.lower_bound(key);
+        ASSERT_EQ(lb == a.end(), ref_lb == ref.end());
+        if (ref_lb != ref.end()) {
+            ASSERT_EQ(*lb, *ref_lb);
+        }
+        auto ub = a.upper_bound(key);
+        auto ref_ub = ref.upper_bound(key);
+        ASSERT_EQ(ub == a.end(), ref_ub == ref.end());
+        if (ref_ub != ref.end()) {
+            ASSERT_EQ(*ub, *ref_ub);
+        }
+    }
+    std::vector<int> backward;
+    for (auto it = a.end(); it != a.begin();) {
+        --it;
+        backward.push_back(*it);
+    }
+    ASSERT_EQ(backward, std::vector<int>(ref.rbegin(), ref.rend()));
+    ASSERT_EQ(std::distance(a.begin(), a.end()), static_cast<std::ptrdiff_t>(ref.size()));
+    auto it = a.begin();
+    ASSERT_EQ(*it++, *ref.begin());
+    ASSERT_EQ(*it, *std::next(ref.begin()));
+}
+
+TEST(ConcurrentTreeTestSuite, Strings) {
+    ConcurrentTree<std::string, std::less<>> a = {"mn", "abc", "zz"};
+    ASSERT_TRUE(a.contains("abc"));
+    ASSERT_EQ(*a.find(std::string_view("mn")), "mn");
+    ASSERT_EQ(a.erase("mn"), 1);
+    ASSERT_TRUE(a.find("mn") == a.end());
+    ASSERT_EQ(Collect(a), (std::vector<std::string>{"abc", "zz"}));
+}
+
+TEST(ConcurrentTreeTestSuite, ConcurrentWriters) {
+    ConcurrentTree<int> a;
+    const int kThreads = 4;
+    const int kPerThread = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&a, t] {
+            std::mt19937 gen(t);
+            for (int i = 0; i < kPerThread; ++i) {
+                a.insert(static_cast<int>(gen() % (kThreads * kPerThread)) * kThreads + t);
+            }
+            for (int i = 0; i < kPerThread; ++i) {
+                int key = static_cast<int>(gen() % (kThreads * kPerThread)) * kThreads + t;
+                if (key % 2 == 0) {
+                    a.erase(key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::set<int> ref;
+    for (int t = 0; t < kThreads; ++t) {
+        std::mt19937 gen(t);
+        for (int i = 0; i < kPerThread; ++i) {
+            ref.insert(static_cast<int>(gen() % (kThreads * kPerThread)) * kThreads + t);
+        }
+        for (int i = 0; i < kPerThread; ++i) {
+            int key = static_cast<int>(gen() % (kThreads * kPerThread)) * kThreads + t;
+            if (key % 2 == 0) {
+                ref.erase(key);
+            }
+        }
+    }
+    ASSERT_EQ(Collect(a), std::vector<int>(ref.begin(), ref.end()));
+    ASSERT_EQ(a.size(), ref.size());
+}
+
+TEST(ConcurrentTreeTestSuite, SortedInsertsStayBalanced) {
+    ConcurrentTree<int> a;
+    const int kCount = 1 << 16;
+    for (int i = 0; i < kCount; ++i) {
+        a.insert(i);
+    }
+    // AVL trees with 2^16 nodes are at most 22 edges high.
+    ASSERT_LE(a.height(), 22);
+    for (int i = kCount - 1; i >= kCount / 2; --i) {
+        a.erase(i);
+    }
+    ASSERT_LE(a.height(), 22);
+    ASSERT_EQ(a.size(), kCount / 2);
+
+    ConcurrentTree<int> b;
+    const int kThreads = 4;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&b, t] {
+            for (int i = 0; i < kCount / kThreads; ++i) {
+                b.insert(i * kThreads + t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(b.size(), kCount);
+    ASSERT_LE(b.height(), 2 * 16 + 2);
+    int expected = 0;
+    for (int x : Collect(b)) {
+        ASSERT_EQ(x, expected++);
+    }
+}
+
+TEST(ConcurrentTreeTestSuite, ContendedMovedStrings) {
+    ConcurrentTree<std::string> a;
+    const int kThreads = 4;
+    const int kKeys = 3000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&a, t] {
+            std::mt19937 gen(t);
+            for (int i = 0; i < kKeys; ++i) {
+                std::string key = "key-" + std::to_string(gen() % kKeys);
+                std::string copy = key;
+                auto res = a.insert(std::move(key));
+                EXPECT_EQ(*res.first, copy);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::set<std::string> ref;
+    for (int t = 0; t < kThreads; ++t) {
+        std::mt19937 gen(t);
+        for (int i = 0; i < kKeys; ++i) {
+            ref.insert("key-" + std::to_string(gen() % kKeys));
+        }
+    }
+    ASSERT_EQ(Collect(a), std::vector<std::string>(ref.begin(), ref.end()));
+    ASSERT_EQ(a.size(), ref.size());
+}
+
+TEST(ConcurrentTreeTestSuite, ReadersDuringWrites) {
+    ConcurrentTree<int> a;
+    for (int i = 0; i < 1000; ++i) {
+        a.insert(2 * i);
+    }
+    std::atomic<bool> stop = false;
+    std::atomic<int> misses = 0;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                for (int i = 0; i < 1000; ++i) {
+                    misses += !a.contains(2 * i);
+                }
+                int previous = -1;
+                for (auto it = a.begin(); it != a.end(); ++it) {
+                    misses += (*it <= previous);
+                    previous = *it;
+                }
+            }
+        });
+    }
+    std::thread writer([&] {
+        std::mt19937 gen(1);
+        for (int i = 0; i < 20000; ++i) {
+            int key = 2 * static_cast<int>(gen() % 1000) + 1;
+            if (gen() % 2 == 0) {
+                a.insert(key);
+            } else {
+                a.erase(key);
+            }
+        }
+    });
+    writer.join();
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(misses, 0);
+    Epoch::collect();
+}
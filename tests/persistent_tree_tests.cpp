@@ -0,0 +1,128 @@
+#include <lib/PersistentTree.cpp>
+#include <gtest/gtest.h>
+#include <vector>
+#include <set>
+#include <random>
+#include <thread>
+#include <string>
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> Collect(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    for (auto it = tree.template begin<OrderType>(); it != tree.template end<OrderType>(); ++it) {
+        ans.push_back(*it);
+    }
+    return ans;
+}
+
+template <typename OrderType, typename Tree>
+std::vector<typename Tree::value_type> CollectBackward(const Tree& tree) {
+    std::vector<typename Tree::value_type> ans;
+    for (auto it = tree.template rbegin<OrderType>(); it != tree.template rend<OrderType>(); ++it) {
+        ans.push_back(*it);
+    }
+    return std::vector<typename Tree::value_type>(ans.rbegin(), ans.rend());
+}
+
+static_assert(std::bidirectional_iterator<PersistentTree<int>::iterator<inorder_tag>>);
+static_assert(std::bidirectional_iterator<PersistentTree<int>::iterator<preorder_tag>>);
+static_assert(std::bidirectional_iterator<PersistentTree<int>::iterator<postorder_tag>>);
+static_assert(std::ranges::bidirectional_range<PersistentTree<int>>);
+
+TEST(PersistentTreeTestSuite, Orders) {
+    PersistentTree<int> a = {1, 2, 3, 4, 5, 6, 7};
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>({1, 2, 3, 4, 5, 6, 7}));
+    ASSERT_EQ(Collect<preorder_tag>(a), std::vector<int>({4, 2, 1, 3, 6, 5, 7}));
+    ASSERT_EQ(Collect<postorder_tag>(a), std::vector<int>({1, 3, 2, 5, 7, 6, 4}));
+    a.erase(1);
+    a.erase(7);
+    a.insert(0);
+    ASSERT_EQ(Collect<preorder_tag>(a), CollectBackward<preorder_tag>(a));
+    ASSERT_EQ(Collect<postorder_tag>(a), CollectBackward<postorder_tag>(a));
+    ASSERT_EQ(Collect<inorder_tag>(a), CollectBackward<inorder_tag>(a));
+    ASSERT_EQ(*a.lower_bound(1), 2);
+    ASSERT_EQ(*a.upper_bound(2), 3);
+    ASSERT_EQ(a.upper_bound(6), a.end());
+    ASSERT_EQ(std::distance(a.begin(), a.end()), 6);
+    auto it = a.begin();
+    ASSERT_EQ(*it++, 0);
+    ASSERT_EQ(*it--, 2);
+    ASSERT_EQ(*it, 0);
+}
+
+TEST(PersistentTreeTestSuite, InsertMovedKeys) {
+    PersistentTree<std::string> a;
+    for (int i = 0; i < 200; ++i) {
+        std::string key = "key-" + std::to_string(i * 7 % 200);
+        std::string expected = key;
+        auto res = a.insert(std::move(key));
+        ASSERT_TRUE(res.second);
+        ASSERT_NE(res.first, a.end());
+        ASSERT_EQ(*res.first, expected);
+    }
+    std::string again = "key-13";
+    auto res = a.insert(std::move(again));
+    ASSERT_FALSE(res.second);
+    ASSERT_EQ(*res.first, "key-13");
+    ASSERT_EQ(a.size(), 200);
+}
+
+TEST(PersistentTreeTestSuite, SnapshotsKeepVersions) {
+    PersistentTree<int> a;
+    std::set<int> ref;
+    std::vector<PersistentTree<int>::snapshot_type> versions;
+    std::vector<std::set<int>> expected;
+    std::mt19937 gen(17);
+    for (int i = 0; i < 20000; ++i) {
+        int key = gen() % 1000;
+        if (gen() % 3 == 0) {
+            ASSERT_EQ(a.erase(key), ref.erase(key));
+        } else {
+            ASSERT_EQ(a.insert(key).second, ref.insert(key).second);
+        }
+        ASSERT_EQ(a.size(), ref.size());
+        if (i % 1000 == 0) {
+            versions.push_back(a.snapshot());
+            expected.push_back(ref);
+        }
+    }
+    ASSERT_EQ(Collect<inorder_tag>(a), std::vector<int>(ref.begin(), ref.end()));
+    for (size_t i = 0; i < versions.size(); ++i) {
+        ASSERT_EQ(versions[i].size(), expected[i].size());
+        ASSERT_EQ(Collect<inorder_tag>(versions[i]), std::vector<int>(expected[i].begin(), expected[i].end()));
+        ASSERT_EQ(Collect<preorder_tag>(versions[i]), CollectBackward<preorder_tag>(versions[i]));
+        ASSERT_EQ(Collect<postorder_tag>(versions[i]), CollectBackward<postorder_tag>(versions[i]));
+        for (int key = 0; key < 1000; key += 7) {
+            ASSERT_EQ(versions[i].contains(key), expected[i].count(key) == 1);
+        }
+    }
+    a.clear();
+    ASSERT_TRUE(a.empty());
+    ASSERT_EQ(versions.back().size(), expected.back().size());
+}
+
+TEST(PersistentTreeTestSuite, ReadersOnSnapshots) {
+    PersistentTree<std::string> a;
+    for (int i = 0; i < 1000; ++i) {
+        a.insert(std::to_string(i));
+    }
+    auto frozen = a.snapshot();
+    std::thread reader([&] {
+        for (int round = 0; round < 20; ++round) {
+            size_t seen = 0;
+            for (auto it = frozen.begin(); it != frozen.end(); ++it) {
+                ++seen;
+            }
+            ASSERT_EQ(seen, 1000u);
+        }
+    });
+    for (int i = 0; i < 1000; i += 2) {
+        a.erase(std::to_string(i));
+        a.insert(std::to_string(i + 5000));
+    }
+    reader.join();
+    ASSERT_EQ(frozen.size(), 1000u);
+    ASSERT_TRUE(frozen.contains("0"));
+    ASSERT_FALSE(a.contains("0"));
+    ASSERT_TRUE(a.contains("5000"));
+}
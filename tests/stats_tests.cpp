@@ -0,0 +1,81 @@
+#include <lib/BST.cpp>
+#include <gtest/gtest.h>
+#include <vector>
+#include <ranges>
+
+TEST(StatsTestSuite, Counters) {
+    BinarySearchTree<int> a;
+    for (int i = 0; i < 100; ++i) {
+        a.insert(i);
+    }
+    auto stats = a.stats();
+    ASSERT_EQ(stats.allocations, 100);
+    ASSERT_EQ(stats.deallocations, 0);
+    ASSERT_EQ(stats.descents, 100);
+    ASSERT_GT(stats.comparisons, 100);
+    ASSERT_LE(stats.max_descent, 12);
+
+    a.reset_stats();
+    a.insert(50);
+    ASSERT_EQ(a.stats().allocations, 0);
+    ASSERT_EQ(a.stats().descents, 1);
+    ASSERT_EQ(a.stats().comparisons, a.stats().descent_steps + 1);
+
+    a.erase(7);
+    a.erase(1000);
+    ASSERT_EQ(a.stats().deallocations, 1);
+    a.clear();
+    ASSERT_EQ(a.stats().deallocations, 100);
+}
+
+TEST(StatsTestSuite, SingleDescentScans) {
+    BinarySearchTree<int> a;
+    for (int i = 0; i < 1000; ++i) {
+        a.insert(i);
+    }
+    a.reset_stats();
+    int sum = 0;
+    for (int x : a.keys_from(500) | std::views::take(100)) {
+        sum += x;
+    }
+    ASSERT_EQ(sum, 54950);
+    ASSERT_EQ(a.stats().descents, 1);
+
+    a.reset_stats();
+    int count = 0;
+    for (int x : a.range(10, 19)) {
+        count += x / 10;
+    }
+    ASSERT_EQ(count, 10);
+    ASSERT_EQ(a.stats().descents, 1);
+
+    a.reset_stats();
+    auto bounds = a.equal_range(700);
+    ASSERT_EQ(*bounds.first, 700);
+    ASSERT_EQ(*bounds.second, 701);
+    ASSERT_EQ(a.stats().descents, 1);
+}
+
+TEST(StatsTestSuite, ShapeStats) {
+    BinarySearchTree<int> empty;
+    ASSERT_EQ(empty.shape_stats().size, 0);
+    ASSERT_EQ(empty.shape_stats().height, 0);
+
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, avl_tag> a = {1, 2, 3, 4, 5, 6, 7};
+    auto shape = a.shape_stats();
+    ASSERT_EQ(shape.size, 7);
+    ASSERT_EQ(shape.height, 2);
+    ASSERT_DOUBLE_EQ(shape.average_depth, 10.0 / 7);
+    ASSERT_EQ(shape.balance_factors, (std::map<long, size_t>{{0, 7}}));
+    ASSERT_GE(shape.memory_bytes, 7 * sizeof(int));
+
+    BinarySearchTree<int, std::less<int>, std::allocator<int>, unbalanced_tag> chain;
+    for (int i = 0; i < 3000; ++i) {
+        chain.insert(i);
+    }
+    auto degenerate = chain.shape_stats();
+    ASSERT_EQ(degenerate.height, 2999);
+    ASSERT_EQ(degenerate.balance_factors.size(), 3000);
+    ASSERT_EQ(degenerate.balance_factors.begin()->first, -2999);
+    ASSERT_EQ(chain.stats().max_descent, 2999);
+}